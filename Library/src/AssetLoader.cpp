@@ -0,0 +1,61 @@
+#include "AssetLoader.h"
+#include "Texture.h"
+
+using namespace dae;
+
+AssetLoader::AssetLoader(uint32_t nrThreads)
+{
+	//hardware_concurrency is allowed to return 0 when it can't tell
+	if (nrThreads == 0)
+	{
+		nrThreads = 1;
+	}
+
+	m_Workers.reserve(nrThreads);
+	for (uint32_t index = 0; index < nrThreads; index++)
+	{
+		m_Workers.emplace_back(&AssetLoader::WorkerLoop, this);
+	}
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_IsStopping = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+std::future<Texture*> AssetLoader::LoadTexture(const std::string& path)
+{
+	return Enqueue([path] { return Texture::LoadFromFile(path); });
+}
+
+void AssetLoader::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> load{};
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_WakeCondition.wait(lock, [this] { return m_IsStopping or m_Loads.empty() == false; });
+
+			//the queue is drained before stopping, a load that never ran would leave its future broken
+			if (m_Loads.empty())
+			{
+				return;
+			}
+
+			load = std::move(m_Loads.front());
+			m_Loads.pop();
+		}
+
+		load();
+	}
+}
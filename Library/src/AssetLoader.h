@@ -0,0 +1,71 @@
+#pragma once
+
+//Standard includes
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace dae
+{
+	class Texture;
+
+	//Background threads for loading assets, every load gets a future the caller checks with IsReady and takes the result from once it's done
+	//separate from ThreadPool, whose workers only ever run one ParallelFor at a time for whoever is waiting on it
+	class AssetLoader final
+	{
+	public:
+		explicit AssetLoader(uint32_t nrThreads = std::thread::hardware_concurrency());
+		//Finishes every load that was already queued, so nothing is still writing into its result afterwards
+		~AssetLoader();
+
+		AssetLoader(const AssetLoader&) = delete;
+		AssetLoader(AssetLoader&&) noexcept = delete;
+		AssetLoader& operator=(const AssetLoader&) = delete;
+		AssetLoader& operator=(AssetLoader&&) noexcept = delete;
+
+		//Runs load() on one of the loader threads, loads are started in the order they are queued
+		template<typename Function>
+		std::future<std::invoke_result_t<Function>> Enqueue(Function&& load)
+		{
+			using Result = std::invoke_result_t<Function>;
+
+			//std::function has to be copyable and a packaged_task isn't, so the queue holds a shared one
+			const auto pTask{ std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(load)) };
+			std::future<Result> future{ pTask->get_future() };
+			{
+				std::lock_guard lock{ m_Mutex };
+				m_Loads.emplace([pTask] { (*pTask)(); });
+			}
+			m_WakeCondition.notify_one();
+			return future;
+		}
+
+		//nullptr when the file couldn't be loaded, same as Texture::LoadFromFile
+		std::future<Texture*> LoadTexture(const std::string& path);
+
+		template<typename T>
+		static bool IsReady(const std::future<T>& future)
+		{
+			return future.valid() and future.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready;
+		}
+
+	private:
+		void WorkerLoop();
+
+		std::vector<std::thread> m_Workers{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WakeCondition{};
+		std::queue<std::function<void()>> m_Loads{};
+		bool m_IsStopping{ false };
+	};
+}
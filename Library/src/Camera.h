@@ -39,6 +39,10 @@ namespace dae
 		Matrix projectionMatrix{};
 		Matrix worldViewProjectionMatrix{};
 
+		//true when the last Update changed the view or projection matrix, anything built from them has to be rebuilt
+		bool hasChanged{ true };
+		bool m_IsViewMatrixDirty{ true };
+
 		float m_CameraMovementSpeed{ 20.0f };
 		float m_CameraRotationSpeed{ 1.5f };
 
@@ -50,6 +54,8 @@ namespace dae
 			origin = _origin;
 
 			ratio = aspectRatio;
+
+			m_IsViewMatrixDirty = true;
 		}
 
 		void CalculateViewMatrix()
@@ -97,6 +103,10 @@ namespace dae
 			//...
 			const float movementSpeed{ m_CameraMovementSpeed * deltaTime };
 
+			const Vector3 previousOrigin{ origin };
+			const float previousPitch{ totalPitch };
+			const float previousYaw{ totalYaw };
+
 			//Keyboard Input
 			const uint8_t* pKeyboardState = SDL_GetKeyboardState(nullptr);
 
@@ -153,6 +163,18 @@ namespace dae
 				origin.y -= mouseY * movementSpeed;
 			}
 
+			//compared exactly, Vector3::operator== would call a small step not moving at all
+			const bool hasMoved{ origin.x != previousOrigin.x or origin.y != previousOrigin.y or origin.z != previousOrigin.z
+				or totalPitch != previousPitch or totalYaw != previousYaw };
+
+			if (m_IsViewMatrixDirty == false and hasMoved == false and fovCheck == fov)
+			{
+				hasChanged = false;
+				return;
+			}
+			hasChanged = true;
+			m_IsViewMatrixDirty = false;
+
 			Matrix rotationMatrix = Matrix::CreateRotation(totalPitch, totalYaw, 0);
 			forward = rotationMatrix.TransformVector(Vector3::UnitZ);
 			forward.Normalize();
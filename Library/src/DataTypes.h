@@ -1,6 +1,9 @@
 #pragma once
 #include "Maths.h"
 #include "vector"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 
 namespace dae
 {
@@ -11,7 +14,6 @@ namespace dae
 		Vector2 uv{}; //W2
 		Vector3 normal{}; //W4
 		Vector3 tangent{}; //W4
-		Vector3 viewDirection{}; //W4
 	};
 
 	struct Vertex_Out
@@ -23,6 +25,19 @@ namespace dae
 			color = vertex.color;
 			uv = vertex.uv;
 		}
+
+		static Vertex_Out Lerp(const Vertex_Out& v1, const Vertex_Out& v2, float factor)
+		{
+			Vertex_Out result{};
+			result.position = v1.position + ((v2.position - v1.position) * factor);
+			result.color = ColorRGB::Lerp(v1.color, v2.color, factor);
+			result.uv = v1.uv + ((v2.uv - v1.uv) * factor);
+			result.normal = v1.normal + ((v2.normal - v1.normal) * factor);
+			result.tangent = v1.tangent + ((v2.tangent - v1.tangent) * factor);
+			result.viewDirection = v1.viewDirection + ((v2.viewDirection - v1.viewDirection) * factor);
+			return result;
+		}
+
 		Vector4 position{};
 		ColorRGB color{ colors::White };
 		Vector2 uv{};
@@ -31,6 +46,253 @@ namespace dae
 		Vector3 viewDirection{};
 	};
 
+	//Mesh vertices split in one stream per component, so the vertex stage can load the same component of several vertices at once
+	//every stream is padded with zeroes up to a multiple of STREAM_PADDING, so a batch never reads past the end
+	//a quantized build only fills the compact streams and a float build only the float ones, the vertex stage decodes the compact ones as it loads them
+	struct VertexStreams
+	{
+		static constexpr int STREAM_PADDING{ 8 };
+		static constexpr int FLOAT_VERTEX_SIZE{ 11 * sizeof(float) };
+		static constexpr int QUANTIZED_VERTEX_SIZE{ 9 * sizeof(uint16_t) };
+
+		//Octahedral snorm16 covers [-1, 1] with this as 1
+		static constexpr float SNORM16_MAX{ 32767.0f };
+		static constexpr float UNORM16_MAX{ 65535.0f };
+
+		int nrVertices{};
+		bool isQuantized{};
+
+		std::vector<float> positionX{};
+		std::vector<float> positionY{};
+		std::vector<float> positionZ{};
+		std::vector<float> normalX{};
+		std::vector<float> normalY{};
+		std::vector<float> normalZ{};
+		std::vector<float> tangentX{};
+		std::vector<float> tangentY{};
+		std::vector<float> tangentZ{};
+		std::vector<Vector2> uvs{};
+
+		//Positions and uvs are unorm16 across the box around them, decoded as offset + quantized * scale
+		std::vector<uint16_t> quantizedPositionX{};
+		std::vector<uint16_t> quantizedPositionY{};
+		std::vector<uint16_t> quantizedPositionZ{};
+		std::vector<uint16_t> quantizedU{};
+		std::vector<uint16_t> quantizedV{};
+		Vector3 positionOffset{};
+		Vector3 positionScale{};
+		Vector2 uvOffset{};
+		Vector2 uvScale{};
+		//Unit vectors folded onto an octahedron and stored as its snorm16 x and y, z follows from those
+		std::vector<int16_t> octahedralNormalX{};
+		std::vector<int16_t> octahedralNormalY{};
+		std::vector<int16_t> octahedralTangentX{};
+		std::vector<int16_t> octahedralTangentY{};
+
+		void Build(const std::vector<Vertex>& vertices, bool quantize = false)
+		{
+			nrVertices = static_cast<int>(vertices.size());
+			isQuantized = quantize;
+			const size_t paddedSize{ static_cast<size_t>(((nrVertices + STREAM_PADDING - 1) / STREAM_PADDING) * STREAM_PADDING) };
+
+			//only one of the layouts is kept around, otherwise quantizing wouldn't save any memory
+			const size_t floatSize{ quantize ? 0 : paddedSize };
+			const size_t quantizedSize{ quantize ? paddedSize : 0 };
+
+			std::vector<float>* floatStreams[]{ &positionX, &positionY, &positionZ, &normalX, &normalY, &normalZ, &tangentX, &tangentY, &tangentZ };
+			for (std::vector<float>* pStream : floatStreams)
+			{
+				pStream->assign(floatSize, 0.0f);
+				pStream->shrink_to_fit();
+			}
+			uvs.assign(floatSize, Vector2{});
+			uvs.shrink_to_fit();
+
+			std::vector<uint16_t>* unormStreams[]{ &quantizedPositionX, &quantizedPositionY, &quantizedPositionZ, &quantizedU, &quantizedV };
+			for (std::vector<uint16_t>* pStream : unormStreams)
+			{
+				pStream->assign(quantizedSize, 0);
+				pStream->shrink_to_fit();
+			}
+			std::vector<int16_t>* snormStreams[]{ &octahedralNormalX, &octahedralNormalY, &octahedralTangentX, &octahedralTangentY };
+			for (std::vector<int16_t>* pStream : snormStreams)
+			{
+				pStream->assign(quantizedSize, 0);
+				pStream->shrink_to_fit();
+			}
+
+			if (quantize)
+			{
+				BuildQuantized(vertices);
+				return;
+			}
+
+			for (int index{}; index < nrVertices; ++index)
+			{
+				const Vertex& vertex{ vertices[index] };
+
+				positionX[index] = vertex.position.x;
+				positionY[index] = vertex.position.y;
+				positionZ[index] = vertex.position.z;
+				normalX[index] = vertex.normal.x;
+				normalY[index] = vertex.normal.y;
+				normalZ[index] = vertex.normal.z;
+				tangentX[index] = vertex.tangent.x;
+				tangentY[index] = vertex.tangent.y;
+				tangentZ[index] = vertex.tangent.z;
+				uvs[index] = vertex.uv;
+			}
+		}
+
+	private:
+		void BuildQuantized(const std::vector<Vertex>& vertices)
+		{
+			if (vertices.empty())
+			{
+				return;
+			}
+
+			Vector3 positionMin{ vertices[0].position };
+			Vector3 positionMax{ vertices[0].position };
+			Vector2 uvMin{ vertices[0].uv };
+			Vector2 uvMax{ vertices[0].uv };
+			for (const Vertex& vertex : vertices)
+			{
+				positionMin = { std::min(positionMin.x, vertex.position.x), std::min(positionMin.y, vertex.position.y), std::min(positionMin.z, vertex.position.z) };
+				positionMax = { std::max(positionMax.x, vertex.position.x), std::max(positionMax.y, vertex.position.y), std::max(positionMax.z, vertex.position.z) };
+				uvMin = { std::min(uvMin.x, vertex.uv.x), std::min(uvMin.y, vertex.uv.y) };
+				uvMax = { std::max(uvMax.x, vertex.uv.x), std::max(uvMax.y, vertex.uv.y) };
+			}
+
+			positionOffset = positionMin;
+			positionScale = { (positionMax.x - positionMin.x) / UNORM16_MAX, (positionMax.y - positionMin.y) / UNORM16_MAX, (positionMax.z - positionMin.z) / UNORM16_MAX };
+			uvOffset = uvMin;
+			uvScale = { (uvMax.x - uvMin.x) / UNORM16_MAX, (uvMax.y - uvMin.y) / UNORM16_MAX };
+
+			for (int index{}; index < nrVertices; ++index)
+			{
+				const Vertex& vertex{ vertices[index] };
+
+				quantizedPositionX[index] = QuantizeUnorm16(vertex.position.x, positionOffset.x, positionScale.x);
+				quantizedPositionY[index] = QuantizeUnorm16(vertex.position.y, positionOffset.y, positionScale.y);
+				quantizedPositionZ[index] = QuantizeUnorm16(vertex.position.z, positionOffset.z, positionScale.z);
+				quantizedU[index] = QuantizeUnorm16(vertex.uv.x, uvOffset.x, uvScale.x);
+				quantizedV[index] = QuantizeUnorm16(vertex.uv.y, uvOffset.y, uvScale.y);
+				EncodeOctahedral(vertex.normal, octahedralNormalX[index], octahedralNormalY[index]);
+				EncodeOctahedral(vertex.tangent, octahedralTangentX[index], octahedralTangentY[index]);
+			}
+		}
+
+		//Rounded to the nearest step, so a decoded value never leaves the box it was quantized in
+		static uint16_t QuantizeUnorm16(float value, float offset, float scale)
+		{
+			if (scale <= 0.0f)
+			{
+				return 0;
+			}
+			return static_cast<uint16_t>(std::clamp((value - offset) / scale + 0.5f, 0.0f, UNORM16_MAX));
+		}
+
+		static void EncodeOctahedral(const Vector3& vector, int16_t& octahedralX, int16_t& octahedralY)
+		{
+			//zero length (or broken) vectors have no direction to keep, they come back as +z
+			const float manhattanLength{ std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z) };
+			if (!(manhattanLength > 0.0f))
+			{
+				octahedralX = 0;
+				octahedralY = 0;
+				return;
+			}
+
+			float x{ vector.x / manhattanLength };
+			float y{ vector.y / manhattanLength };
+			//the lower half of the octahedron is folded over the upper half's corners
+			if (vector.z < 0.0f)
+			{
+				const float foldedX{ (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f) };
+				const float foldedY{ (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f) };
+				x = foldedX;
+				y = foldedY;
+			}
+
+			octahedralX = static_cast<int16_t>(std::round(std::clamp(x, -1.0f, 1.0f) * SNORM16_MAX));
+			octahedralY = static_cast<int16_t>(std::round(std::clamp(y, -1.0f, 1.0f) * SNORM16_MAX));
+		}
+	};
+
+	//Post-transform vertices, split hot/cold
+	//culling, clipping, screen space conversion and binning only ever walk positions, the rest is read once per triangle that survives
+	//color isn't carried, nothing after the vertex stage reads it
+	struct VertexOutStreams
+	{
+		std::vector<Vector4> positions{};
+		std::vector<Vector2> uvs{};
+		std::vector<Vector3> normals{};
+		std::vector<Vector3> tangents{};
+		std::vector<Vector3> viewDirections{};
+		//screen x and y, ndc z and clip w, filled in as triangles get rasterized
+		//kept apart from positions so the clip space results can be reused while nothing moves
+		std::vector<Vector4> screenPositions{};
+
+		size_t GetSize() const
+		{
+			return positions.size();
+		}
+
+		void Resize(size_t size)
+		{
+			positions.resize(size);
+			uvs.resize(size);
+			normals.resize(size);
+			tangents.resize(size);
+			viewDirections.resize(size);
+			screenPositions.resize(size);
+		}
+
+		Vertex_Out Get(size_t index) const
+		{
+			Vertex_Out vertex{};
+			vertex.position = positions[index];
+			vertex.uv = uvs[index];
+			vertex.normal = normals[index];
+			vertex.tangent = tangents[index];
+			vertex.viewDirection = viewDirections[index];
+			return vertex;
+		}
+
+		void PushBack(const Vertex_Out& vertex)
+		{
+			positions.push_back(vertex.position);
+			uvs.push_back(vertex.uv);
+			normals.push_back(vertex.normal);
+			tangents.push_back(vertex.tangent);
+			viewDirections.push_back(vertex.viewDirection);
+			screenPositions.push_back({});
+		}
+	};
+
+	//A small cluster of a triangle list that owns a contiguous range of the indices
+	//its vertices are shared with the meshlets around it, firstVertex and nrVertices are the range of Mesh::meshletVertices that lists them
+	//bounds are in object space
+	struct Meshlet
+	{
+		uint32_t firstVertex{};
+		uint32_t nrVertices{};
+		uint32_t firstIndex{};
+		uint32_t nrTriangles{};
+
+		Vector3 center{};
+		float radius{};
+
+		//every face normal is within the cone around coneAxis, coneSine is the sine of its half angle
+		//a cone of 90 degrees or wider can't ever be fully back facing, those have isConeValid set to false
+		Vector3 coneAxis{};
+		float coneSine{};
+		bool isConeValid{};
+		//spelled out, so MeshCache never writes bytes the compiler left uninitialized
+		uint8_t padding[3]{};
+	};
+
 	enum class PrimitiveTopology
 	{
 		TriangleList,
@@ -39,11 +301,18 @@ namespace dae
 
 	struct Mesh
 	{
+		//vertices as they were loaded, only kept until BuildVertexStreams turns them into vertexStreams, which is all the renderer reads
+		//the load time steps (optimizing, meshlets, bounds, the mesh cache) and the unit tests are the only users of them
 		std::vector<Vertex> vertices{};
 		std::vector<uint32_t> indices{};
 		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleStrip };
 
-		std::vector<Vertex_Out> vertices_out{};
+		VertexStreams vertexStreams{};
+		//empty unless the triangle list was split with MeshOptimizer::BuildMeshlets
+		std::vector<Meshlet> meshlets{};
+		//indices into vertices, every meshlet's range of it holds each vertex its triangles use once
+		std::vector<uint32_t> meshletVertices{};
+		VertexOutStreams vertices_out{};
 		std::vector<bool> isVertex_outInScreenSpace{};
 		Matrix worldMatrix{};
 
@@ -51,24 +320,95 @@ namespace dae
 		Matrix translationTransform{};
 		Matrix scaleTransform{};
 
+		//box around the vertices in object space, set by CalculateBounds once the vertices are loaded
+		Vector3 localBoundsMin{};
+		Vector3 localBoundsMax{};
+		//box around the transformed local bounds, kept up to date by Update so culling doesn't touch the vertices
+		Vector3 worldBoundsMin{};
+		Vector3 worldBoundsMax{};
+
+		//Builds vertexStreams and sizes the output streams from vertices, then releases vertices,
+		//keeping them around would store every vertex twice
+		void BuildVertexStreams(bool quantize)
+		{
+			vertexStreams.Build(vertices, quantize);
+			vertices_out.Resize(vertices.size());
+			isVertex_outInScreenSpace.resize(vertices.size());
+
+			vertices.clear();
+			vertices.shrink_to_fit();
+		}
+
+		void CalculateBounds()
+		{
+			//the world bounds are built from these, so they are stale too
+			isTransformDirty = true;
+
+			if (vertices.empty())
+			{
+				localBoundsMin = {};
+				localBoundsMax = {};
+				return;
+			}
+
+			localBoundsMin = vertices[0].position;
+			localBoundsMax = vertices[0].position;
+			for (const Vertex& vertex : vertices)
+			{
+				localBoundsMin = { std::min(localBoundsMin.x, vertex.position.x), std::min(localBoundsMin.y, vertex.position.y), std::min(localBoundsMin.z, vertex.position.z) };
+				localBoundsMax = { std::max(localBoundsMax.x, vertex.position.x), std::max(localBoundsMax.y, vertex.position.y), std::max(localBoundsMax.z, vertex.position.z) };
+			}
+		}
+
+		//set by the transform helpers, Update only rebuilds the world matrix and bounds when something moved
+		bool isTransformDirty{ true };
+		//true when the last Update changed the world matrix
+		bool hasChanged{ true };
+
 		void Translate(const Vector3& translation)
 		{
 			translationTransform = Matrix::CreateTranslation(translation);
+			isTransformDirty = true;
 		}
 
 		void RotateY(float yaw)
 		{
 			rotationTransform = Matrix::CreateRotationY(yaw);
+			isTransformDirty = true;
 		}
 
 		void Scale(const Vector3& scale)
 		{
 			scaleTransform = Matrix::CreateScale(scale);
+			isTransformDirty = true;
 		}
 
 		void Update()
 		{
+			hasChanged = isTransformDirty;
+			if (isTransformDirty == false)
+			{
+				return;
+			}
+			isTransformDirty = false;
+
 			worldMatrix = scaleTransform * rotationTransform * translationTransform;
+
+			//the center is transformed as a point, every world axis of the extent sums how much each local axis reaches into it
+			const Vector3 localCenter{ (localBoundsMin + localBoundsMax) * 0.5f };
+			const Vector3 localExtent{ (localBoundsMax - localBoundsMin) * 0.5f };
+
+			const Vector3 worldCenter{ worldMatrix.TransformPoint(localCenter) };
+			Vector3 worldExtent{};
+			for (int row{}; row < 3; ++row)
+			{
+				worldExtent.x += std::abs(worldMatrix[row][0]) * localExtent[row];
+				worldExtent.y += std::abs(worldMatrix[row][1]) * localExtent[row];
+				worldExtent.z += std::abs(worldMatrix[row][2]) * localExtent[row];
+			}
+
+			worldBoundsMin = worldCenter - worldExtent;
+			worldBoundsMax = worldCenter + worldExtent;
 		}
 	};
 }
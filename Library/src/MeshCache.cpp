@@ -0,0 +1,211 @@
+#include "MeshCache.h"
+#include "DataTypes.h"
+#include "MappedFile.h"
+
+//Standard includes
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+using namespace dae;
+
+namespace
+{
+	//'GPMC' when read as little endian bytes
+	constexpr uint32_t MAGIC{ 0x434D5047 };
+
+	//Struct sizes are stored so a cache written by a build with another Vertex or Meshlet layout is never read as this one
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t buildFlags;
+		uint32_t vertexSize;
+		uint32_t meshletSize;
+		uint32_t padding;
+
+		uint64_t nrVertices;
+		uint64_t vertexOffset;
+		uint64_t nrIndices;
+		uint64_t indexOffset;
+		uint64_t nrMeshlets;
+		uint64_t meshletOffset;
+		uint64_t nrMeshletVertices;
+		uint64_t meshletVertexOffset;
+
+		float boundsMin[3];
+		float boundsMax[3];
+	};
+
+	//Vertices and meshlets are written and read as raw bytes, which only works as long as they stay plain floats and ints
+	static_assert(std::is_standard_layout_v<Vertex>, "Vertex has to stay plain data to be cached");
+	static_assert(std::is_standard_layout_v<Meshlet>, "Meshlet has to stay plain data to be cached");
+	//the same mesh has to give the same file, so nothing can be left to padding the compiler adds
+	static_assert(sizeof(Meshlet) == offsetof(Meshlet, padding) + sizeof(Meshlet::padding), "Meshlet can't have padding of its own");
+
+	uint64_t AlignSection(uint64_t offset)
+	{
+		return (offset + MeshCache::SECTION_ALIGNMENT - 1) / MeshCache::SECTION_ALIGNMENT * MeshCache::SECTION_ALIGNMENT;
+	}
+
+	//Offsets come out of the file, so a truncated or damaged one can't point past the end of the mapping
+	bool IsSectionInFile(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize)
+	{
+		return offset % MeshCache::SECTION_ALIGNMENT == 0 and offset <= fileSize and count <= (fileSize - offset) / elementSize;
+	}
+}
+
+uint64_t MeshCache::HashSourceFile(const std::string& sourceFilename)
+{
+	const MappedFile file{ sourceFilename };
+	if (!file.IsOpen())
+	{
+		return 0;
+	}
+
+	uint64_t hash{ 0xcbf29ce484222325 };
+	const unsigned char* pData{ reinterpret_cast<const unsigned char*>(file.GetData()) };
+	for (size_t index = 0; index < file.GetSize(); index++)
+	{
+		hash ^= pData[index];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+bool MeshCache::Load(const std::string& cacheFilename, uint64_t sourceHash, uint32_t buildFlags, Mesh& mesh)
+{
+	const MappedFile file{ cacheFilename };
+	if (!file.IsOpen() or file.GetSize() < sizeof(Header))
+	{
+		return false;
+	}
+
+	Header header{};
+	std::memcpy(&header, file.GetData(), sizeof(Header));
+	if (header.magic != MAGIC or header.version != VERSION or header.sourceHash != sourceHash or header.buildFlags != buildFlags
+		or header.vertexSize != sizeof(Vertex) or header.meshletSize != sizeof(Meshlet))
+	{
+		return false;
+	}
+
+	const uint64_t fileSize{ file.GetSize() };
+	if (!IsSectionInFile(header.vertexOffset, header.nrVertices, sizeof(Vertex), fileSize)
+		or !IsSectionInFile(header.indexOffset, header.nrIndices, sizeof(uint32_t), fileSize)
+		or !IsSectionInFile(header.meshletOffset, header.nrMeshlets, sizeof(Meshlet), fileSize)
+		or !IsSectionInFile(header.meshletVertexOffset, header.nrMeshletVertices, sizeof(uint32_t), fileSize))
+	{
+		return false;
+	}
+
+	const Vertex* pVertices{ reinterpret_cast<const Vertex*>(file.GetData() + header.vertexOffset) };
+	const uint32_t* pIndices{ reinterpret_cast<const uint32_t*>(file.GetData() + header.indexOffset) };
+	const Meshlet* pMeshlets{ reinterpret_cast<const Meshlet*>(file.GetData() + header.meshletOffset) };
+	const uint32_t* pMeshletVertices{ reinterpret_cast<const uint32_t*>(file.GetData() + header.meshletVertexOffset) };
+
+	//Everything the renderer indexes with has to stay inside the arrays, whatever ended up in the file
+	for (uint64_t index{}; index < header.nrIndices; ++index)
+	{
+		if (pIndices[index] >= header.nrVertices)
+		{
+			return false;
+		}
+	}
+	for (uint64_t meshletVertex{}; meshletVertex < header.nrMeshletVertices; ++meshletVertex)
+	{
+		if (pMeshletVertices[meshletVertex] >= header.nrVertices)
+		{
+			return false;
+		}
+	}
+	for (uint64_t meshletIndex{}; meshletIndex < header.nrMeshlets; ++meshletIndex)
+	{
+		const Meshlet& meshlet{ pMeshlets[meshletIndex] };
+		if (uint64_t{ meshlet.firstVertex } + meshlet.nrVertices > header.nrMeshletVertices
+			or uint64_t{ meshlet.firstIndex } + (uint64_t{ meshlet.nrTriangles } * 3) > header.nrIndices)
+		{
+			return false;
+		}
+	}
+
+	//The mesh owns its arrays, so every section is one bulk copy out of the mapping instead of a parse
+	mesh.vertices.assign(pVertices, pVertices + header.nrVertices);
+	mesh.indices.assign(pIndices, pIndices + header.nrIndices);
+	mesh.meshlets.assign(pMeshlets, pMeshlets + header.nrMeshlets);
+	mesh.meshletVertices.assign(pMeshletVertices, pMeshletVertices + header.nrMeshletVertices);
+
+	mesh.localBoundsMin = { header.boundsMin[0], header.boundsMin[1], header.boundsMin[2] };
+	mesh.localBoundsMax = { header.boundsMax[0], header.boundsMax[1], header.boundsMax[2] };
+	mesh.isTransformDirty = true;
+	return true;
+}
+
+bool MeshCache::Save(const std::string& cacheFilename, uint64_t sourceHash, uint32_t buildFlags, const Mesh& mesh)
+{
+	//memset instead of {}, so any padding in the header is zero too
+	Header header;
+	std::memset(&header, 0, sizeof(Header));
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.sourceHash = sourceHash;
+	header.buildFlags = buildFlags;
+	header.vertexSize = sizeof(Vertex);
+	header.meshletSize = sizeof(Meshlet);
+
+	header.nrVertices = mesh.vertices.size();
+	header.vertexOffset = AlignSection(sizeof(Header));
+	header.nrIndices = mesh.indices.size();
+	header.indexOffset = AlignSection(header.vertexOffset + header.nrVertices * sizeof(Vertex));
+	header.nrMeshlets = mesh.meshlets.size();
+	header.meshletOffset = AlignSection(header.indexOffset + header.nrIndices * sizeof(uint32_t));
+	header.nrMeshletVertices = mesh.meshletVertices.size();
+	header.meshletVertexOffset = AlignSection(header.meshletOffset + header.nrMeshlets * sizeof(Meshlet));
+
+	header.boundsMin[0] = mesh.localBoundsMin.x;
+	header.boundsMin[1] = mesh.localBoundsMin.y;
+	header.boundsMin[2] = mesh.localBoundsMin.z;
+	header.boundsMax[0] = mesh.localBoundsMax.x;
+	header.boundsMax[1] = mesh.localBoundsMax.y;
+	header.boundsMax[2] = mesh.localBoundsMax.z;
+
+	//Written next to the cache and renamed over it once complete, so a crash or a full disk never leaves a cache that is only half there
+	const std::string tempFilename{ cacheFilename + ".tmp" };
+	std::ofstream file{ tempFilename, std::ios::binary | std::ios::trunc };
+	if (!file)
+	{
+		return false;
+	}
+
+	//Pads the file with zeroes up to where the next section starts
+	const auto writeSection{ [&file](uint64_t offset, const void* pData, uint64_t size)
+		{
+			static constexpr char zeroes[MeshCache::SECTION_ALIGNMENT]{};
+			file.write(zeroes, static_cast<std::streamsize>(offset - static_cast<uint64_t>(file.tellp())));
+			file.write(static_cast<const char*>(pData), static_cast<std::streamsize>(size));
+		} };
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	writeSection(header.vertexOffset, mesh.vertices.data(), header.nrVertices * sizeof(Vertex));
+	writeSection(header.indexOffset, mesh.indices.data(), header.nrIndices * sizeof(uint32_t));
+	writeSection(header.meshletOffset, mesh.meshlets.data(), header.nrMeshlets * sizeof(Meshlet));
+	writeSection(header.meshletVertexOffset, mesh.meshletVertices.data(), header.nrMeshletVertices * sizeof(uint32_t));
+	file.close();
+
+	std::error_code error{};
+	if (file.fail())
+	{
+		std::filesystem::remove(tempFilename, error);
+		return false;
+	}
+
+	std::filesystem::rename(tempFilename, cacheFilename, error);
+	if (error)
+	{
+		std::filesystem::remove(tempFilename, error);
+		return false;
+	}
+	return true;
+}
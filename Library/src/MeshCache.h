@@ -0,0 +1,29 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	struct Mesh;
+
+	//Binary copy of a loaded mesh (vertices with their tangents, indices, meshlets with their vertex lists and bounds) written next to the file it came from
+	//every section starts on a SECTION_ALIGNMENT boundary in the file, so a mapping of it can be read as arrays in place
+	namespace MeshCache
+	{
+		//Bump whenever the OBJ parser, the load time optimizations or the layout of the file change, older caches are rebuilt then
+		static constexpr uint32_t VERSION{ 4 };
+		static constexpr uint64_t SECTION_ALIGNMENT{ 64 };
+		static constexpr const char* FILE_EXTENSION{ ".meshcache" };
+
+		//FNV-1a over the bytes of the source file, 0 if it can't be read
+		uint64_t HashSourceFile(const std::string& sourceFilename);
+
+		//buildFlags is whatever the caller did to the mesh after parsing it, a cache built with other flags or from other source bytes is stale
+		//Load only touches the mesh when the cache is fresh, complete and every index and meshlet range in it is inside its array
+		bool Load(const std::string& cacheFilename, uint64_t sourceHash, uint32_t buildFlags, Mesh& mesh);
+		//Writes cacheFilename.tmp and renames it over cacheFilename, an existing cache is only ever replaced by a whole one
+		bool Save(const std::string& cacheFilename, uint64_t sourceHash, uint32_t buildFlags, const Mesh& mesh);
+	}
+}
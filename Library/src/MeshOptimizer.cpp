@@ -0,0 +1,542 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	namespace MeshOptimizer
+	{
+		static constexpr uint32_t INVALID_INDEX{ UINT32_MAX };
+		//a triangle only joins a meshlet when its normal is within 60 degrees of the meshlet's average normal so far,
+		//without this the normal cones end up too wide to ever cull anything
+		static constexpr float MESHLET_MIN_NORMAL_COSINE{ 0.5f };
+
+		//Number of vertices a FIFO post-transform cache of cacheSize has to transform for these indices
+		static uint32_t CountCacheMisses(const std::vector<uint32_t>& indices, uint32_t nrVertices, uint32_t cacheSize)
+		{
+			//a vertex is still cached when it was inserted less than cacheSize misses ago
+			std::vector<uint32_t> insertTime(nrVertices, 0);
+			uint32_t nrMisses{};
+
+			for (const uint32_t index : indices)
+			{
+				if (insertTime[index] == 0 or nrMisses - insertTime[index] + 1 > cacheSize)
+				{
+					++nrMisses;
+					insertTime[index] = nrMisses;
+				}
+			}
+
+			return nrMisses;
+		}
+
+		//vertex -> triangles using it, as one flat array with an offset per vertex
+		static void BuildTriangleAdjacency(const std::vector<uint32_t>& indices, uint32_t nrVertices, std::vector<uint32_t>& adjacencyOffsets, std::vector<uint32_t>& adjacency)
+		{
+			const uint32_t nrTriangleIndices{ static_cast<uint32_t>(indices.size() / 3) * 3 };
+
+			adjacencyOffsets.assign(nrVertices + 1, 0);
+			for (uint32_t index{}; index < nrTriangleIndices; ++index)
+			{
+				++adjacencyOffsets[indices[index] + 1];
+			}
+
+			for (uint32_t vertex{}; vertex < nrVertices; ++vertex)
+			{
+				adjacencyOffsets[vertex + 1] += adjacencyOffsets[vertex];
+			}
+
+			adjacency.resize(adjacencyOffsets[nrVertices]);
+			std::vector<uint32_t> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t index{}; index < nrTriangleIndices; ++index)
+			{
+				adjacency[fillOffsets[indices[index]]++] = index / 3;
+			}
+		}
+
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t nrVertices, uint32_t cacheSize)
+		{
+			const uint32_t nrTriangles{ static_cast<uint32_t>(indices.size() / 3) };
+			if (nrTriangles == 0)
+			{
+				return;
+			}
+
+			std::vector<uint32_t> adjacencyOffsets{};
+			std::vector<uint32_t> adjacency{};
+			BuildTriangleAdjacency(indices, nrVertices, adjacencyOffsets, adjacency);
+
+			std::vector<uint32_t> liveTriangles(nrVertices, 0);
+			for (uint32_t vertex{}; vertex < nrVertices; ++vertex)
+			{
+				liveTriangles[vertex] = adjacencyOffsets[vertex + 1] - adjacencyOffsets[vertex];
+			}
+
+			std::vector<uint32_t> cacheTime(nrVertices, 0);
+			std::vector<bool> isEmitted(nrTriangles, false);
+			std::vector<uint32_t> deadEnds{};
+			std::vector<uint32_t> candidates{};
+
+			std::vector<uint32_t> optimizedIndices{};
+			optimizedIndices.reserve(nrTriangles * 3);
+
+			uint32_t time{ cacheSize + 1 };
+			uint32_t cursor{};
+			uint32_t fanningVertex{ 0 };
+
+			while (fanningVertex != INVALID_INDEX)
+			{
+				candidates.clear();
+
+				//emit every triangle around the fanning vertex that hasn't been emitted yet
+				for (uint32_t adjacencyIndex{ adjacencyOffsets[fanningVertex] }; adjacencyIndex < adjacencyOffsets[fanningVertex + 1]; ++adjacencyIndex)
+				{
+					const uint32_t triangle{ adjacency[adjacencyIndex] };
+					if (isEmitted[triangle])
+					{
+						continue;
+					}
+
+					for (uint32_t corner{}; corner < 3; ++corner)
+					{
+						const uint32_t vertex{ indices[(triangle * 3) + corner] };
+
+						optimizedIndices.push_back(vertex);
+						deadEnds.push_back(vertex);
+						candidates.push_back(vertex);
+						--liveTriangles[vertex];
+
+						if (time - cacheTime[vertex] > cacheSize)
+						{
+							cacheTime[vertex] = time++;
+						}
+					}
+
+					isEmitted[triangle] = true;
+				}
+
+				//continue with the candidate that still has work left and will stay in the cache while its fan is emitted
+				uint32_t nextVertex{ INVALID_INDEX };
+				int64_t bestPriority{ -1 };
+				for (const uint32_t vertex : candidates)
+				{
+					if (liveTriangles[vertex] == 0)
+					{
+						continue;
+					}
+
+					int64_t priority{ 0 };
+					if (time - cacheTime[vertex] + (2 * liveTriangles[vertex]) <= cacheSize)
+					{
+						priority = time - cacheTime[vertex];
+					}
+
+					if (priority > bestPriority)
+					{
+						bestPriority = priority;
+						nextVertex = vertex;
+					}
+				}
+
+				//dead end, go back to the most recently used vertex with triangles left, or the next one in input order
+				while (nextVertex == INVALID_INDEX and deadEnds.empty() == false)
+				{
+					const uint32_t vertex{ deadEnds.back() };
+					deadEnds.pop_back();
+
+					if (liveTriangles[vertex] > 0)
+					{
+						nextVertex = vertex;
+					}
+				}
+
+				while (nextVertex == INVALID_INDEX and cursor < nrVertices)
+				{
+					if (liveTriangles[cursor] > 0)
+					{
+						nextVertex = cursor;
+					}
+					++cursor;
+				}
+
+				fanningVertex = nextVertex;
+			}
+
+			//anything past the last whole triangle is kept where it was
+			std::copy(optimizedIndices.begin(), optimizedIndices.end(), indices.begin());
+		}
+
+		void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			const uint32_t nrVertices{ static_cast<uint32_t>(vertices.size()) };
+
+			std::vector<uint32_t> remap(nrVertices, INVALID_INDEX);
+			uint32_t nrRemapped{};
+
+			for (uint32_t& index : indices)
+			{
+				if (remap[index] == INVALID_INDEX)
+				{
+					remap[index] = nrRemapped++;
+				}
+				index = remap[index];
+			}
+
+			for (uint32_t vertex{}; vertex < nrVertices; ++vertex)
+			{
+				if (remap[vertex] == INVALID_INDEX)
+				{
+					remap[vertex] = nrRemapped++;
+				}
+			}
+
+			std::vector<Vertex> remappedVertices(nrVertices);
+			for (uint32_t vertex{}; vertex < nrVertices; ++vertex)
+			{
+				remappedVertices[remap[vertex]] = vertices[vertex];
+			}
+			vertices.swap(remappedVertices);
+		}
+
+		//Unit normal in the winding the triangle is rasterized with, zero for a degenerate triangle
+		static Vector3 CalculateFaceNormal(const std::vector<Vertex>& vertices, const uint32_t* pTriangleIndices)
+		{
+			const Vector3& v0{ vertices[pTriangleIndices[0]].position };
+			const Vector3& v1{ vertices[pTriangleIndices[1]].position };
+			const Vector3& v2{ vertices[pTriangleIndices[2]].position };
+
+			const Vector3 cross{ Vector3::Cross(v1 - v0, v2 - v0) };
+			const float length{ cross.Magnitude() };
+			return (length > FLT_EPSILON) ? cross / length : Vector3{};
+		}
+
+		//Bounding sphere around the vertices and a cone that holds every face normal of the meshlet
+		static void CalculateMeshletBounds(Meshlet& meshlet, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<uint32_t>& meshletVertices)
+		{
+			const uint32_t lastMeshletVertex{ meshlet.firstVertex + meshlet.nrVertices };
+
+			Vector3 minPosition{ vertices[meshletVertices[meshlet.firstVertex]].position };
+			Vector3 maxPosition{ minPosition };
+			for (uint32_t meshletVertex{ meshlet.firstVertex }; meshletVertex < lastMeshletVertex; ++meshletVertex)
+			{
+				const Vector3& position{ vertices[meshletVertices[meshletVertex]].position };
+				minPosition = { std::min(minPosition.x, position.x), std::min(minPosition.y, position.y), std::min(minPosition.z, position.z) };
+				maxPosition = { std::max(maxPosition.x, position.x), std::max(maxPosition.y, position.y), std::max(maxPosition.z, position.z) };
+			}
+
+			meshlet.center = (minPosition + maxPosition) * 0.5f;
+			meshlet.radius = 0.0f;
+			for (uint32_t meshletVertex{ meshlet.firstVertex }; meshletVertex < lastMeshletVertex; ++meshletVertex)
+			{
+				meshlet.radius = std::max(meshlet.radius, (vertices[meshletVertices[meshletVertex]].position - meshlet.center).Magnitude());
+			}
+
+			//face normals follow the winding the triangles are rasterized with, degenerate triangles don't face anywhere
+			std::vector<Vector3> faceNormals{};
+			faceNormals.reserve(meshlet.nrTriangles);
+			Vector3 normalSum{};
+			for (uint32_t index{ meshlet.firstIndex }; index < meshlet.firstIndex + (meshlet.nrTriangles * 3); index += 3)
+			{
+				const Vector3 faceNormal{ CalculateFaceNormal(vertices, &indices[index]) };
+				if (faceNormal.SqrMagnitude() == 0.0f)
+				{
+					continue;
+				}
+
+				faceNormals.push_back(faceNormal);
+				normalSum += faceNormal;
+			}
+
+			meshlet.isConeValid = false;
+			meshlet.coneAxis = normalSum;
+			if (faceNormals.empty() or meshlet.coneAxis.Normalize() <= FLT_EPSILON)
+			{
+				return;
+			}
+
+			float minCosine{ 1.0f };
+			for (const Vector3& faceNormal : faceNormals)
+			{
+				minCosine = std::min(minCosine, Vector3::Dot(faceNormal, meshlet.coneAxis));
+			}
+
+			if (minCosine <= 0.0f)
+			{
+				return;
+			}
+
+			meshlet.coneSine = sqrtf(1.0f - (minCosine * minCosine));
+			meshlet.isConeValid = true;
+		}
+
+		void BuildMeshlets(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<uint32_t>& meshletVertices, std::vector<Meshlet>& meshlets, uint32_t maxVertices, uint32_t maxTriangles)
+		{
+			meshlets.clear();
+			meshletVertices.clear();
+
+			const uint32_t nrVertices{ static_cast<uint32_t>(vertices.size()) };
+			const uint32_t nrTriangles{ static_cast<uint32_t>(indices.size() / 3) };
+			if (nrTriangles == 0)
+			{
+				return;
+			}
+
+			std::vector<uint32_t> adjacencyOffsets{};
+			std::vector<uint32_t> adjacency{};
+			BuildTriangleAdjacency(indices, nrVertices, adjacencyOffsets, adjacency);
+
+			std::vector<Vector3> faceNormals(nrTriangles);
+			for (uint32_t triangle{}; triangle < nrTriangles; ++triangle)
+			{
+				faceNormals[triangle] = CalculateFaceNormal(vertices, &indices[triangle * 3]);
+			}
+
+			meshletVertices.reserve(vertices.size());
+			std::vector<uint32_t> meshletIndices{};
+			meshletIndices.reserve(nrTriangles * 3);
+
+			//set for every vertex the meshlet that is being filled uses, cleared again when a new meshlet starts
+			std::vector<bool> isInMeshlet(nrVertices, false);
+			std::vector<bool> isEmitted(nrTriangles, false);
+
+			Meshlet meshlet{};
+			Vector3 normalSum{};
+			uint32_t cursor{};
+
+			while (true)
+			{
+				//grow the meshlet with the triangle next to it that adds the fewest vertices, ties go to the one that keeps the normal cone tight
+				uint32_t nextTriangle{ INVALID_INDEX };
+				float bestScore{ FLT_MAX };
+				const float normalSumLength{ normalSum.Magnitude() };
+				const Vector3 coneAxis{ (normalSumLength > FLT_EPSILON) ? normalSum / normalSumLength : Vector3{} };
+
+				//degenerate triangles don't face anywhere, so they fit in any cone, and anything fits while the meshlet has no direction yet
+				const auto calculateNormalCosine{ [&](uint32_t triangle)
+					{
+						if (faceNormals[triangle].SqrMagnitude() == 0.0f or coneAxis.SqrMagnitude() == 0.0f)
+						{
+							return 1.0f;
+						}
+						return Vector3::Dot(faceNormals[triangle], coneAxis);
+					} };
+
+				for (uint32_t meshletVertex{ meshlet.firstVertex }; meshletVertex < meshlet.firstVertex + meshlet.nrVertices; ++meshletVertex)
+				{
+					const uint32_t vertex{ meshletVertices[meshletVertex] };
+					for (uint32_t adjacencyIndex{ adjacencyOffsets[vertex] }; adjacencyIndex < adjacencyOffsets[vertex + 1]; ++adjacencyIndex)
+					{
+						const uint32_t triangle{ adjacency[adjacencyIndex] };
+						if (isEmitted[triangle])
+						{
+							continue;
+						}
+
+						uint32_t nrNewVertices{};
+						for (uint32_t corner{}; corner < 3; ++corner)
+						{
+							if (isInMeshlet[indices[(triangle * 3) + corner]] == false)
+							{
+								++nrNewVertices;
+							}
+						}
+
+						const float normalCosine{ calculateNormalCosine(triangle) };
+						if (meshlet.nrVertices + nrNewVertices > maxVertices or normalCosine < MESHLET_MIN_NORMAL_COSINE)
+						{
+							continue;
+						}
+
+						const float score{ nrNewVertices + (1.0f - normalCosine) };
+						if (score < bestScore)
+						{
+							bestScore = score;
+							nextTriangle = triangle;
+						}
+					}
+				}
+
+				//nothing next to it fits, the first triangle left in index order can still join when it faces the same way
+				//the cache optimization put that one close to the triangles before it
+				while (cursor < nrTriangles and isEmitted[cursor])
+				{
+					++cursor;
+				}
+
+				if (nextTriangle == INVALID_INDEX and cursor < nrTriangles and meshlet.nrVertices + 3 <= maxVertices and
+					calculateNormalCosine(cursor) >= MESHLET_MIN_NORMAL_COSINE)
+				{
+					nextTriangle = cursor;
+				}
+
+				if (nextTriangle == INVALID_INDEX or meshlet.nrTriangles == maxTriangles)
+				{
+					if (meshlet.nrTriangles > 0)
+					{
+						meshlets.push_back(meshlet);
+					}
+
+					for (uint32_t meshletVertex{ meshlet.firstVertex }; meshletVertex < meshlet.firstVertex + meshlet.nrVertices; ++meshletVertex)
+					{
+						isInMeshlet[meshletVertices[meshletVertex]] = false;
+					}
+
+					meshlet = {};
+					meshlet.firstVertex = static_cast<uint32_t>(meshletVertices.size());
+					meshlet.firstIndex = static_cast<uint32_t>(meshletIndices.size());
+					normalSum = {};
+
+					if (cursor == nrTriangles)
+					{
+						break;
+					}
+					nextTriangle = cursor;
+				}
+
+				for (uint32_t corner{}; corner < 3; ++corner)
+				{
+					const uint32_t vertex{ indices[(nextTriangle * 3) + corner] };
+					if (isInMeshlet[vertex] == false)
+					{
+						isInMeshlet[vertex] = true;
+						meshletVertices.push_back(vertex);
+						++meshlet.nrVertices;
+					}
+					meshletIndices.push_back(vertex);
+				}
+
+				isEmitted[nextTriangle] = true;
+				normalSum += faceNormals[nextTriangle];
+				++meshlet.nrTriangles;
+			}
+
+			//vertices are renumbered in the order the meshlets first use them, so the ones a meshlet adds sit together
+			//and the vertex stage can skip the ranges that only culled meshlets use
+			//anything past the last whole triangle can't be drawn, so it is dropped along with the vertices no triangle uses
+			std::vector<uint32_t> remap(nrVertices, INVALID_INDEX);
+			std::vector<Vertex> remappedVertices{};
+			remappedVertices.reserve(vertices.size());
+			for (uint32_t& vertex : meshletVertices)
+			{
+				if (remap[vertex] == INVALID_INDEX)
+				{
+					remap[vertex] = static_cast<uint32_t>(remappedVertices.size());
+					remappedVertices.push_back(vertices[vertex]);
+				}
+				vertex = remap[vertex];
+			}
+
+			for (uint32_t& index : meshletIndices)
+			{
+				index = remap[index];
+			}
+
+			vertices.swap(remappedVertices);
+			indices.swap(meshletIndices);
+
+			for (Meshlet& builtMeshlet : meshlets)
+			{
+				CalculateMeshletBounds(builtMeshlet, vertices, indices, meshletVertices);
+			}
+		}
+
+		void OptimizeMeshlets(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<uint32_t>& meshletVertices, const std::vector<Meshlet>& meshlets, uint32_t cacheSize)
+		{
+			const uint32_t nrVertices{ static_cast<uint32_t>(vertices.size()) };
+
+			//position of every vertex in the meshlet being optimized, only valid for that meshlet's vertices
+			std::vector<uint32_t> localVertices(nrVertices, INVALID_INDEX);
+			std::vector<uint32_t> localIndices{};
+			std::vector<uint32_t> firstUseOrder{};
+
+			for (const Meshlet& meshlet : meshlets)
+			{
+				const uint32_t lastMeshletVertex{ meshlet.firstVertex + meshlet.nrVertices };
+				const uint32_t lastIndex{ meshlet.firstIndex + (meshlet.nrTriangles * 3) };
+
+				for (uint32_t meshletVertex{ meshlet.firstVertex }; meshletVertex < lastMeshletVertex; ++meshletVertex)
+				{
+					localVertices[meshletVertices[meshletVertex]] = meshletVertex - meshlet.firstVertex;
+				}
+
+				localIndices.clear();
+				for (uint32_t index{ meshlet.firstIndex }; index < lastIndex; ++index)
+				{
+					localIndices.push_back(localVertices[indices[index]]);
+				}
+
+				OptimizeVertexCache(localIndices, meshlet.nrVertices, cacheSize);
+
+				//the meshlet's vertices are listed in the order its new triangle order first uses them
+				firstUseOrder.clear();
+				for (uint32_t localIndex{}; localIndex < localIndices.size(); ++localIndex)
+				{
+					const uint32_t vertex{ meshletVertices[meshlet.firstVertex + localIndices[localIndex]] };
+					indices[meshlet.firstIndex + localIndex] = vertex;
+
+					if (localVertices[vertex] != INVALID_INDEX)
+					{
+						localVertices[vertex] = INVALID_INDEX;
+						firstUseOrder.push_back(vertex);
+					}
+				}
+				std::copy(firstUseOrder.begin(), firstUseOrder.end(), meshletVertices.begin() + meshlet.firstVertex);
+			}
+
+			//meshlets and their index ranges follow each other, so walking meshletVertices meets every vertex in the order the whole index buffer first uses it
+			std::vector<uint32_t> remap(nrVertices, INVALID_INDEX);
+			std::vector<Vertex> remappedVertices{};
+			remappedVertices.reserve(vertices.size());
+			for (uint32_t& vertex : meshletVertices)
+			{
+				if (remap[vertex] == INVALID_INDEX)
+				{
+					remap[vertex] = static_cast<uint32_t>(remappedVertices.size());
+					remappedVertices.push_back(vertices[vertex]);
+				}
+				vertex = remap[vertex];
+			}
+
+			for (uint32_t& index : indices)
+			{
+				index = remap[index];
+			}
+
+			vertices.swap(remappedVertices);
+		}
+
+		float CalculateACMR(const std::vector<uint32_t>& indices, uint32_t nrVertices, uint32_t cacheSize)
+		{
+			const size_t nrTriangles{ indices.size() / 3 };
+			if (nrTriangles == 0)
+			{
+				return 0.0f;
+			}
+
+			return static_cast<float>(CountCacheMisses(indices, nrVertices, cacheSize)) / nrTriangles;
+		}
+
+		float CalculateATVR(const std::vector<uint32_t>& indices, uint32_t nrVertices, uint32_t cacheSize)
+		{
+			std::vector<bool> isReferenced(nrVertices, false);
+			uint32_t nrReferenced{};
+			for (const uint32_t index : indices)
+			{
+				if (isReferenced[index] == false)
+				{
+					isReferenced[index] = true;
+					++nrReferenced;
+				}
+			}
+
+			if (nrReferenced == 0)
+			{
+				return 0.0f;
+			}
+
+			return static_cast<float>(CountCacheMisses(indices, nrVertices, cacheSize)) / nrReferenced;
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <vector>
+
+namespace dae
+{
+	struct Vertex;
+	struct Meshlet;
+
+	//Load time reordering of indexed triangle lists, winding of every triangle is kept as is
+	namespace MeshOptimizer
+	{
+		//Tipsify (Sander et al.), reorders triangles so vertices are reused while they are still in a FIFO cache of cacheSize
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t nrVertices, uint32_t cacheSize = 16);
+
+		//Renumbers vertices in the order the indices first use them, so the vertex stage reads them front to back
+		//vertices that no triangle uses are moved to the end
+		void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		//Splits the triangle list into meshlets of at most maxVertices vertices and maxTriangles triangles, grown over neighbouring triangles that face roughly the same way
+		//meshlets share the vertices on their borders, meshletVertices lists the vertices of every meshlet and Meshlet::firstVertex points into it
+		//indices are rewritten meshlet by meshlet and vertices renumbered in the order the meshlets use them
+		void BuildMeshlets(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<uint32_t>& meshletVertices, std::vector<Meshlet>& meshlets, uint32_t maxVertices = 64, uint32_t maxTriangles = 124);
+
+		//OptimizeVertexCache on the triangles of every meshlet on their own, BuildMeshlets reorders the triangles so any order from before it is lost
+		//meshletVertices and the vertices are then put in the order the new indices first use them, the meshlets keep their triangles, vertices and bounds
+		void OptimizeMeshlets(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<uint32_t>& meshletVertices, const std::vector<Meshlet>& meshlets, uint32_t cacheSize = 16);
+
+		//Average cache miss ratio: transformed vertices per triangle with a FIFO cache of cacheSize, 0.5 is the best a big mesh can do
+		float CalculateACMR(const std::vector<uint32_t>& indices, uint32_t nrVertices, uint32_t cacheSize = 16);
+		//Average transform to vertex ratio: transformed vertices per referenced vertex, 1 is perfect
+		float CalculateATVR(const std::vector<uint32_t>& indices, uint32_t nrVertices, uint32_t cacheSize = 16);
+	}
+}
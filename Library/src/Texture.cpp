@@ -39,6 +39,21 @@ namespace dae
 		return texture;
 	}
 
+	Texture* Texture::CreateSolid(const ColorRGB& color)
+	{
+		SDL_Surface* pSurface{ SDL_CreateRGBSurface(0, 1, 1, 32, 0, 0, 0, 0) };
+		if (!pSurface)
+		{
+			return nullptr;
+		}
+
+		SDL_FillRect(pSurface, nullptr, SDL_MapRGB(pSurface->format,
+			static_cast<uint8_t>(std::clamp(color.r, 0.0f, 1.0f) * 255),
+			static_cast<uint8_t>(std::clamp(color.g, 0.0f, 1.0f) * 255),
+			static_cast<uint8_t>(std::clamp(color.b, 0.0f, 1.0f) * 255)));
+		return new Texture{ pSurface };
+	}
+
 	ColorRGB Texture::Sample(const Vector2& uv) const
 	{
 		//TODO
@@ -47,8 +62,9 @@ namespace dae
 
 		const float u = std::clamp(uv.x, 0.0f, 1.0f);
 		const float v = std::clamp(uv.y, 0.0f, 1.0f);
-		const size_t px = static_cast<size_t>(u * m_pSurface->w);
-		const size_t py = static_cast<size_t>(v * m_pSurface->h);
+		//a uv of exactly 1 would land one texel past the edge
+		const size_t px = std::min(static_cast<size_t>(u * m_pSurface->w), static_cast<size_t>(m_pSurface->w - 1));
+		const size_t py = std::min(static_cast<size_t>(v * m_pSurface->h), static_cast<size_t>(m_pSurface->h - 1));
 
 		SDL_GetRGB(m_pSurfacePixels[(py * m_pSurface->w) + px], m_pSurface->format, &r, &g, &b);
 
@@ -14,6 +14,8 @@ namespace dae
 		Texture();
 
 		static Texture* LoadFromFile(const std::string& path);
+		//1x1 texture of a single color, stands in for a texture that is still being loaded
+		static Texture* CreateSolid(const ColorRGB& color);
 		ColorRGB Sample(const Vector2& uv) const;
 
 	private:
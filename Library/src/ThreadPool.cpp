@@ -0,0 +1,104 @@
+#include "ThreadPool.h"
+
+using namespace dae;
+
+ThreadPool::ThreadPool(uint32_t nrThreads)
+{
+	//hardware_concurrency is allowed to return 0 when it can't tell
+	if (nrThreads == 0)
+	{
+		nrThreads = 1;
+	}
+
+	m_Workers.reserve(nrThreads - 1);
+	for (uint32_t index = 0; index < nrThreads - 1; index++)
+	{
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_IsStopping = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	//Not worth waking anyone up for
+	if (count == 1 or m_Workers.empty())
+	{
+		for (uint32_t index = 0; index < count; index++)
+		{
+			job(index);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_pJob = &job;
+		m_JobCount = count;
+		m_NextJobIndex = 0;
+		m_NrBusyWorkers = static_cast<uint32_t>(m_Workers.size());
+		++m_Generation;
+	}
+	m_WakeCondition.notify_all();
+
+	//The calling thread helps out instead of idling
+	RunJobs();
+
+	std::unique_lock lock{ m_Mutex };
+	m_DoneCondition.wait(lock, [this] { return m_NrBusyWorkers == 0; });
+	m_pJob = nullptr;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	uint64_t lastGeneration{};
+
+	while (true)
+	{
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_WakeCondition.wait(lock, [&] { return m_IsStopping or m_Generation != lastGeneration; });
+
+			if (m_IsStopping)
+			{
+				return;
+			}
+
+			lastGeneration = m_Generation;
+		}
+
+		RunJobs();
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			--m_NrBusyWorkers;
+		}
+		m_DoneCondition.notify_one();
+	}
+}
+
+void ThreadPool::RunJobs()
+{
+	//Indices are handed out one at a time so uneven jobs (busy vs empty tiles) still balance out
+	for (uint32_t index = m_NextJobIndex++; index < m_JobCount; index = m_NextJobIndex++)
+	{
+		(*m_pJob)(index);
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+//Standard includes
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	class ThreadPool final
+	{
+	public:
+		//nrThreads includes the calling thread, so a pool of 1 runs everything inline
+		explicit ThreadPool(uint32_t nrThreads = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		//Calls job(index) for every index in [0, count) on the workers and the calling thread
+		//Returns once every index has been processed
+		void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job);
+
+		uint32_t GetNrThreads() const { return static_cast<uint32_t>(m_Workers.size()) + 1; }
+
+	private:
+		void WorkerLoop();
+		void RunJobs();
+
+		std::vector<std::thread> m_Workers{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WakeCondition{};
+		std::condition_variable m_DoneCondition{};
+
+		const std::function<void(uint32_t)>* m_pJob{ nullptr };
+		uint32_t m_JobCount{};
+		std::atomic<uint32_t> m_NextJobIndex{};
+
+		uint32_t m_NrBusyWorkers{};
+		uint64_t m_Generation{};
+		bool m_IsStopping{ false };
+	};
+}
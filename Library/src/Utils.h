@@ -1,8 +1,13 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
-#include <fstream>
+#include <charconv>
+#include <cstring>
+#include <string>
 #include "Maths.h"
 #include "DataTypes.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
 
 //#define DISABLE_OBJ
 
@@ -10,125 +15,432 @@ namespace dae
 {
 	namespace Utils
 	{
-		//Just parses vertices and indices
-#pragma warning(push)
-#pragma warning(disable : 4505) //Warning unreferenced local function
-		static bool ParseOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding = true)
+		//Files are only split in chunks of at least this size, smaller ones aren't worth waking the workers for
+		static constexpr size_t OBJ_MIN_CHUNK_SIZE{ 256 * 1024 };
+		//More chunks than threads so a chunk with a lot of faces doesn't hold everyone up
+		static constexpr uint32_t OBJ_CHUNKS_PER_THREAD{ 4 };
+
+		//a face corner is a position/uv/normal triplet, corners with the same triplet become the same vertex
+		//0 means the corner doesn't have one
+		struct ObjCorner
 		{
-#ifdef DISABLE_OBJ
+			size_t iPosition;
+			size_t iTexCoord;
+			size_t iNormal;
 
-			//TODO: Enable the code below after uncommenting all the vertex attributes of DataTypes::Vertex
-			// >> Comment/Remove '#define DISABLE_OBJ'
-			assert(false && "OBJ PARSER not enabled! Check the comments in Utils::ParseOBJ");
+			bool operator==(const ObjCorner& other) const
+			{
+				return iPosition == other.iPosition and iTexCoord == other.iTexCoord and iNormal == other.iNormal;
+			}
+		};
 
-#else
+		//Open addressing with linear probing instead of a node based map, so deduplicating is a single allocation
+		//kept at most half full, iPosition 0 marks an empty slot since OBJ indices start at 1
+		class ObjCornerTable final
+		{
+		public:
+			explicit ObjCornerTable(size_t maxNrCorners)
+			{
+				size_t nrSlots{ 16 };
+				while (nrSlots < maxNrCorners * 2)
+				{
+					nrSlots *= 2;
+				}
+				m_Slots.resize(nrSlots, Slot{});
+				m_SlotMask = nrSlots - 1;
+			}
 
-			std::ifstream file(filename);
-			if (!file)
-				return false;
+			//Returns the index stored for the corner and whether it was new, new corners get newIndex
+			std::pair<uint32_t, bool> Insert(const ObjCorner& corner, uint32_t newIndex)
+			{
+				size_t hash{ std::hash<size_t>{}(corner.iPosition) };
+				hash ^= std::hash<size_t>{}(corner.iTexCoord) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+				hash ^= std::hash<size_t>{}(corner.iNormal) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+
+				size_t iSlot{ hash & m_SlotMask };
+				while (m_Slots[iSlot].corner.iPosition != 0 and !(m_Slots[iSlot].corner == corner))
+				{
+					iSlot = (iSlot + 1) & m_SlotMask;
+				}
+
+				Slot& slot{ m_Slots[iSlot] };
+				if (slot.corner.iPosition != 0)
+				{
+					return { slot.index, false };
+				}
+
+				slot = Slot{ corner, newIndex };
+				return { newIndex, true };
+			}
+
+		private:
+			struct Slot
+			{
+				ObjCorner corner;
+				uint32_t index;
+			};
+
+			std::vector<Slot> m_Slots{};
+			size_t m_SlotMask{};
+		};
+
+		//Everything one run of lines of the file holds, indices point into its own corners until the chunks are merged
+		struct ObjChunk
+		{
+			const char* pBegin{};
+			const char* pEnd{};
 
 			std::vector<Vector3> positions{};
 			std::vector<Vector3> normals{};
 			std::vector<Vector2> UVs{};
+			//Unique corners in the order the chunk first uses them
+			std::vector<ObjCorner> corners{};
+			std::vector<uint32_t> indices{};
 
-			vertices.clear();
-			indices.clear();
+			//Filled in by the merge: the chunk's offsets in the file wide arrays and the file wide vertex of each of its corners
+			size_t firstPosition{};
+			size_t firstNormal{};
+			size_t firstUV{};
+			size_t firstIndex{};
+			std::vector<uint32_t> cornerToVertex{};
 
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
+			bool isValid{ true };
+		};
+
+#pragma warning(push)
+#pragma warning(disable : 4505) //Warning unreferenced local function
+		//Scanning helpers for ParseOBJ, they never read at or past pEnd
+		static const char* SkipSpaces(const char* pCurrent, const char* pEnd)
+		{
+			while (pCurrent < pEnd and (*pCurrent == ' ' or *pCurrent == '\t' or *pCurrent == '\r'))
+			{
+				++pCurrent;
+			}
+			return pCurrent;
+		}
+
+		static const char* SkipLine(const char* pCurrent, const char* pEnd)
+		{
+			const void* pNewLine{ std::memchr(pCurrent, '\n', size_t(pEnd - pCurrent)) };
+			return pNewLine ? static_cast<const char*>(pNewLine) + 1 : pEnd;
+		}
+
+		//Returns the first char after the number, or nullptr if there is no number
+		template<typename T>
+		static const char* ParseNumber(const char* pCurrent, const char* pEnd, T& value)
+		{
+			pCurrent = SkipSpaces(pCurrent, pEnd);
+			//from_chars doesn't take a leading '+', streams do
+			if (pCurrent < pEnd and *pCurrent == '+')
+			{
+				++pCurrent;
+			}
+
+			const auto [pNext, error] { std::from_chars(pCurrent, pEnd, value) };
+			return error == std::errc{} ? pNext : nullptr;
+		}
+
+		//Parses the v/vt/vn/f lines between chunk.pBegin and chunk.pEnd, which have to start and end on a line boundary
+		//face indices aren't checked against the pools here, the positions they point at can live in an earlier chunk
+		static bool ParseOBJChunk(ObjChunk& chunk, bool flipAxisAndWinding)
+		{
+			const char* pCurrent{ chunk.pBegin };
+			const char* const pEnd{ chunk.pEnd };
+
+			//Counting the lines up front is a lot cheaper than letting every pool grow while parsing
+			//nrFaces has to stay an upper bound (the corner table relies on it), so every line starting with 'f' counts
+			size_t nrPositions{}, nrUVs{}, nrNormals{}, nrFaces{};
+			for (const char* pLine{ pCurrent }; pLine < pEnd; pLine = SkipLine(pLine, pEnd))
 			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
+				pLine = SkipSpaces(pLine, pEnd);
+				if (pEnd - pLine < 2)
 				{
-					// Ignore Comment
+					nrFaces += pLine < pEnd and pLine[0] == 'f';
 				}
-				else if (sCommand == "v")
+				else if (pLine[0] == 'v')
+				{
+					nrPositions += pLine[1] == ' ';
+					nrUVs += pLine[1] == 't';
+					nrNormals += pLine[1] == 'n';
+				}
+				else
+				{
+					nrFaces += pLine[0] == 'f';
+				}
+			}
+			chunk.positions.reserve(nrPositions);
+			chunk.UVs.reserve(nrUVs);
+			chunk.normals.reserve(nrNormals);
+			chunk.indices.reserve(nrFaces * 3);
+			chunk.corners.reserve(nrFaces * 3);
+
+			ObjCornerTable cornerTable{ nrFaces * 3 };
+
+			while (pCurrent < pEnd)
+			{
+				//read the first word of the line, blank lines are skipped over
+				while (pCurrent < pEnd and (*pCurrent == ' ' or *pCurrent == '\t' or *pCurrent == '\r' or *pCurrent == '\n'))
+				{
+					++pCurrent;
+				}
+				const char* const pCommand{ pCurrent };
+				while (pCurrent < pEnd and *pCurrent != ' ' and *pCurrent != '\t' and *pCurrent != '\r' and *pCurrent != '\n')
+				{
+					++pCurrent;
+				}
+				const size_t commandLength{ size_t(pCurrent - pCommand) };
+
+				//use conditional statements to process the different commands, anything else (comments, groups, ...) is ignored
+				if (commandLength == 1 and pCommand[0] == 'v')
 				{
 					//Vertex
 					float x, y, z;
-					file >> x >> y >> z;
+					if (!(pCurrent = ParseNumber(pCurrent, pEnd, x)) or !(pCurrent = ParseNumber(pCurrent, pEnd, y)) or !(pCurrent = ParseNumber(pCurrent, pEnd, z)))
+						return false;
 
-					positions.emplace_back(x, y, z);
+					chunk.positions.emplace_back(x, y, z);
 				}
-				else if (sCommand == "vt")
+				else if (commandLength == 2 and pCommand[0] == 'v' and pCommand[1] == 't')
 				{
 					// Vertex TexCoord
 					float u, v;
-					file >> u >> v;
-					UVs.emplace_back(u, 1 - v);
+					if (!(pCurrent = ParseNumber(pCurrent, pEnd, u)) or !(pCurrent = ParseNumber(pCurrent, pEnd, v)))
+						return false;
+
+					chunk.UVs.emplace_back(u, 1 - v);
 				}
-				else if (sCommand == "vn")
+				else if (commandLength == 2 and pCommand[0] == 'v' and pCommand[1] == 'n')
 				{
 					// Vertex Normal
 					float x, y, z;
-					file >> x >> y >> z;
+					if (!(pCurrent = ParseNumber(pCurrent, pEnd, x)) or !(pCurrent = ParseNumber(pCurrent, pEnd, y)) or !(pCurrent = ParseNumber(pCurrent, pEnd, z)))
+						return false;
 
-					normals.emplace_back(x, y, z);
+					chunk.normals.emplace_back(x, y, z);
 				}
-				else if (sCommand == "f")
+				else if (commandLength == 1 and pCommand[0] == 'f')
 				{
 					//if a face is read:
-					//construct the 3 vertices, add them to the vertex array
+					//look up the 3 corners, add the new ones to the corner array
 					//add three indices to the index array
-					//add the material index as attibute to the attribute array
 					//
 					// Faces or triangles
-					Vertex vertex{};
-					size_t iPosition, iTexCoord, iNormal;
-
 					uint32_t tempIndices[3];
 					for (size_t iFace = 0; iFace < 3; iFace++)
 					{
+						ObjCorner corner{};
+
 						// OBJ format uses 1-based arrays
-						file >> iPosition;
-						vertex.position = positions[iPosition - 1];
+						if (!(pCurrent = ParseNumber(pCurrent, pEnd, corner.iPosition)) or corner.iPosition == 0)
+							return false;
 
-						if ('/' == file.peek())//is next in buffer ==  '/' ?
+						if (pCurrent < pEnd and *pCurrent == '/')
 						{
-							file.ignore();//read and ignore one element ('/')
+							++pCurrent;
 
-							if ('/' != file.peek())
+							if (pCurrent < pEnd and *pCurrent != '/')
 							{
 								// Optional texture coordinate
-								file >> iTexCoord;
-								vertex.uv = UVs[iTexCoord - 1];
+								if (!(pCurrent = ParseNumber(pCurrent, pEnd, corner.iTexCoord)) or corner.iTexCoord == 0)
+									return false;
 							}
 
-							if ('/' == file.peek())
+							if (pCurrent < pEnd and *pCurrent == '/')
 							{
-								file.ignore();
+								++pCurrent;
 
 								// Optional vertex normal
-								file >> iNormal;
-								vertex.normal = normals[iNormal - 1];
+								if (!(pCurrent = ParseNumber(pCurrent, pEnd, corner.iNormal)) or corner.iNormal == 0)
+									return false;
 							}
 						}
 
-						vertices.push_back(vertex);
-						tempIndices[iFace] = uint32_t(vertices.size()) - 1;
-						//indices.push_back(uint32_t(vertices.size()) - 1);
+						const auto [cornerIndex, isNewCorner] = cornerTable.Insert(corner, uint32_t(chunk.corners.size()));
+						if (isNewCorner)
+						{
+							chunk.corners.push_back(corner);
+						}
+						tempIndices[iFace] = cornerIndex;
 					}
 
-					indices.push_back(tempIndices[0]);
-					if (flipAxisAndWinding) 
+					chunk.indices.push_back(tempIndices[0]);
+					if (flipAxisAndWinding)
 					{
-						indices.push_back(tempIndices[2]);
-						indices.push_back(tempIndices[1]);
+						chunk.indices.push_back(tempIndices[2]);
+						chunk.indices.push_back(tempIndices[1]);
 					}
 					else
 					{
-						indices.push_back(tempIndices[1]);
-						indices.push_back(tempIndices[2]);
+						chunk.indices.push_back(tempIndices[1]);
+						chunk.indices.push_back(tempIndices[2]);
 					}
 				}
 				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
+				pCurrent = SkipLine(pCurrent, pEnd);
+			}
+
+			return true;
+		}
+
+		//Just parses vertices and indices
+		//the file is mapped and scanned in place, so the only allocations are the output, the pools and the corner tables, all sized up front
+		//with a pThreadPool, big files are split at line boundaries and the chunks are parsed in parallel
+		//the chunks are merged in file order, so the result is exactly what parsing it in one go gives
+		static bool ParseOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding = true, ThreadPool* pThreadPool = nullptr)
+		{
+#ifdef DISABLE_OBJ
+
+			//TODO: Enable the code below after uncommenting all the vertex attributes of DataTypes::Vertex
+			// >> Comment/Remove '#define DISABLE_OBJ'
+			assert(false && "OBJ PARSER not enabled! Check the comments in Utils::ParseOBJ");
+
+#else
+
+			const MappedFile file{ filename };
+			if (!file.IsOpen())
+				return false;
+
+			vertices.clear();
+			indices.clear();
+
+			const char* const pFileBegin{ file.GetData() };
+			const char* const pFileEnd{ pFileBegin + file.GetSize() };
+
+			uint32_t nrChunks{ 1 };
+			if (pThreadPool)
+			{
+				nrChunks = uint32_t(std::clamp<size_t>(file.GetSize() / OBJ_MIN_CHUNK_SIZE, 1, pThreadPool->GetNrThreads() * OBJ_CHUNKS_PER_THREAD));
+			}
+
+			const auto forEachChunk{ [&](const std::function<void(uint32_t)>& job)
+				{
+					if (pThreadPool)
+					{
+						pThreadPool->ParallelFor(nrChunks, job);
+						return;
+					}
+
+					for (uint32_t chunkIndex = 0; chunkIndex < nrChunks; chunkIndex++)
+					{
+						job(chunkIndex);
+					}
+				} };
+
+			//Every chunk ends right after the first newline past its even share of the file
+			std::vector<ObjChunk> chunks(nrChunks);
+			const char* pChunkBegin{ pFileBegin };
+			for (uint32_t chunkIndex = 0; chunkIndex < nrChunks; chunkIndex++)
+			{
+				ObjChunk& chunk{ chunks[chunkIndex] };
+				chunk.pBegin = pChunkBegin;
+				if (chunkIndex == nrChunks - 1)
+				{
+					chunk.pEnd = pFileEnd;
+				}
+				else
+				{
+					const char* const pSplit{ pFileBegin + file.GetSize() * (chunkIndex + 1) / nrChunks };
+					chunk.pEnd = SkipLine(std::max(pChunkBegin, pSplit - 1), pFileEnd);
+				}
+				pChunkBegin = chunk.pEnd;
+			}
+
+			forEachChunk([&](uint32_t chunkIndex)
+				{
+					chunks[chunkIndex].isValid = ParseOBJChunk(chunks[chunkIndex], flipAxisAndWinding);
+				});
+
+			//Prefix sums over the chunk sizes place every chunk in the file wide arrays
+			//corners are deduplicated a second time across chunks, in file order so vertices keep the order they are first used in
+			size_t nrPositions{}, nrNormals{}, nrUVs{}, nrIndices{}, nrChunkCorners{};
+			for (const ObjChunk& chunk : chunks)
+			{
+				if (!chunk.isValid)
+					return false;
+
+				nrChunkCorners += chunk.corners.size();
+			}
+
+			ObjCornerTable cornerTable{ nrChunkCorners };
+			std::vector<ObjCorner> corners{};
+			corners.reserve(nrChunkCorners);
+			for (ObjChunk& chunk : chunks)
+			{
+				chunk.firstPosition = nrPositions;
+				chunk.firstNormal = nrNormals;
+				chunk.firstUV = nrUVs;
+				chunk.firstIndex = nrIndices;
+				nrPositions += chunk.positions.size();
+				nrNormals += chunk.normals.size();
+				nrUVs += chunk.UVs.size();
+				nrIndices += chunk.indices.size();
+
+				chunk.cornerToVertex.resize(chunk.corners.size());
+				for (size_t cornerIndex = 0; cornerIndex < chunk.corners.size(); cornerIndex++)
+				{
+					const auto [vertexIndex, isNewVertex] = cornerTable.Insert(chunk.corners[cornerIndex], uint32_t(corners.size()));
+					if (isNewVertex)
+					{
+						corners.push_back(chunk.corners[cornerIndex]);
+					}
+					chunk.cornerToVertex[cornerIndex] = vertexIndex;
+				}
+			}
+
+			std::vector<Vector3> positions(nrPositions);
+			std::vector<Vector3> normals(nrNormals);
+			std::vector<Vector2> UVs(nrUVs);
+			indices.resize(nrIndices);
+			forEachChunk([&](uint32_t chunkIndex)
+				{
+					const ObjChunk& chunk{ chunks[chunkIndex] };
+					std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.firstPosition);
+					std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.firstNormal);
+					std::copy(chunk.UVs.begin(), chunk.UVs.end(), UVs.begin() + chunk.firstUV);
+
+					for (size_t index = 0; index < chunk.indices.size(); index++)
+					{
+						indices[chunk.firstIndex + index] = chunk.cornerToVertex[chunk.indices[index]];
+					}
+				});
+
+			//The pools are complete now, so this is where the indices of the corners get checked
+			vertices.resize(corners.size());
+			forEachChunk([&](uint32_t chunkIndex)
+				{
+					const size_t firstVertex{ corners.size() * chunkIndex / nrChunks };
+					const size_t lastVertex{ corners.size() * (chunkIndex + 1) / nrChunks };
+					for (size_t vertexIndex = firstVertex; vertexIndex < lastVertex; vertexIndex++)
+					{
+						const ObjCorner& corner{ corners[vertexIndex] };
+						if (corner.iPosition > positions.size() or corner.iTexCoord > UVs.size() or corner.iNormal > normals.size())
+						{
+							chunks[chunkIndex].isValid = false;
+							return;
+						}
+
+						Vertex& vertex{ vertices[vertexIndex] };
+						vertex.position = positions[corner.iPosition - 1];
+						if (corner.iTexCoord != 0)
+							vertex.uv = UVs[corner.iTexCoord - 1];
+						if (corner.iNormal != 0)
+							vertex.normal = normals[corner.iNormal - 1];
+					}
+				});
+
+			for (const ObjChunk& chunk : chunks)
+			{
+				if (!chunk.isValid)
+				{
+					vertices.clear();
+					indices.clear();
+					return false;
+				}
 			}
 
 			//Cheap Tangent Calculations
+			//shared vertices add up the tangent of every face they're part of
+			//stays serial, the sums have to be added up in the same order every time to get the same floats
 			for (uint32_t i = 0; i < indices.size(); i += 3)
 			{
 				uint32_t index0 = indices[i];
@@ -173,4 +485,4 @@ namespace dae
 		}
 #pragma warning(pop)
 	}
-}
\ No newline at end of file
+}
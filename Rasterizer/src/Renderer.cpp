@@ -4,10 +4,20 @@
 
 //Project includes
 #include "Renderer.h"
+#include "AssetLoader.h"
 #include "Maths.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
 #include "Texture.h"
+#include "ThreadPool.h"
 #include "Utils.h"
+#include <bit>
+#include <chrono>
 #include <iostream>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 using namespace dae;
 
@@ -23,28 +33,62 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
 
 	m_pDepthBufferPixels = new float[m_Width * m_Height];
+	m_pVisibilityBufferPixels = new uint32_t[m_Width * m_Height];
+
+	//Initialize Tiles
+	m_NrTilesX = (m_Width + TILE_SIZE - 1) / TILE_SIZE;
+	m_NrTilesY = (m_Height + TILE_SIZE - 1) / TILE_SIZE;
+	m_TileBins.resize(m_NrTilesX * m_NrTilesY);
+	m_TileMaxDepth.resize(m_NrTilesX * m_NrTilesY);
+	m_TileStats.resize(m_NrTilesX * m_NrTilesY);
+
+	m_NrHiZBlocksX = (m_Width + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+	m_NrHiZBlocksY = (m_Height + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE;
+	m_HiZMaxDepth.resize(m_NrHiZBlocksX * m_NrHiZBlocksY);
+
+	m_pThreadPool = new ThreadPool();
+	m_IsAVX2Supported = IsAVX2Supported();
 
 	//Initialize Camera
 	m_Camera.Initialize(45.0f, { 0.0f, 5.0f, -64.0f }, (static_cast<float>(m_Width) / m_Height));
 
+	//Placeholders until the loads below are done, an empty mesh draws nothing and the textures shade it like a flat, dull surface
 	m_Mesh = new Mesh();
+	m_Mesh->primitiveTopology = PrimitiveTopology::TriangleList;
 
 	m_ModelYRotation = 0.0f;
 
-	m_DiffuseTexture	= m_DiffuseTexture->LoadFromFile("Resources/vehicle_diffuse.png");
-	m_NormalsTexture	= m_NormalsTexture->LoadFromFile("Resources/vehicle_normal.png");
-	m_SpecularTexture   = m_SpecularTexture->LoadFromFile("Resources/vehicle_specular.png");
-	m_GlossinessTexture = m_GlossinessTexture->LoadFromFile("Resources/vehicle_gloss.png");
+	m_DiffuseTexture	= Texture::CreateSolid(colors::Gray);
+	m_NormalsTexture	= Texture::CreateSolid(ColorRGB{ 0.5f, 0.5f, 1.0f });
+	m_SpecularTexture   = Texture::CreateSolid(colors::Black);
+	m_GlossinessTexture = Texture::CreateSolid(colors::Black);
 
-	Utils::ParseOBJ("Resources/vehicle.obj", m_Mesh->vertices, m_Mesh->indices);
-	m_Mesh->vertices_out.resize(m_Mesh->vertices.size());
-	m_Mesh->primitiveTopology = PrimitiveTopology::TriangleList;
+	//Everything loads at the same time on the loader threads, the mesh goes first since it takes the longest
+	m_pAssetLoader = new AssetLoader{ NR_ASSET_LOADER_THREADS };
+	m_LoadStart = std::chrono::steady_clock::now();
+	EnqueueMeshLoad();
 
-	m_Mesh->isVertex_outInScreenSpace.resize(m_Mesh->vertices.size());
+	m_PendingTextures.push_back({ m_pAssetLoader->LoadTexture("Resources/vehicle_diffuse.png"), &m_DiffuseTexture });
+	m_PendingTextures.push_back({ m_pAssetLoader->LoadTexture("Resources/vehicle_normal.png"), &m_NormalsTexture });
+	m_PendingTextures.push_back({ m_pAssetLoader->LoadTexture("Resources/vehicle_specular.png"), &m_SpecularTexture });
+	m_PendingTextures.push_back({ m_pAssetLoader->LoadTexture("Resources/vehicle_gloss.png"), &m_GlossinessTexture });
 }
 
 Renderer::~Renderer()
 {
+	//Waits for the loads that are still running, their results never got swapped in so they are deleted here
+	delete m_pAssetLoader;
+	for (PendingTexture& pendingTexture : m_PendingTextures)
+	{
+		delete pendingTexture.future.get();
+	}
+	if (m_PendingMesh.valid())
+	{
+		delete m_PendingMesh.get();
+	}
+
+	delete m_pThreadPool;
+	delete[] m_pVisibilityBufferPixels;
 	delete[] m_pDepthBufferPixels;
 	delete m_SpecularTexture;
 	delete m_GlossinessTexture;
@@ -53,12 +97,149 @@ Renderer::~Renderer()
 	delete m_Mesh;
 }
 
+void Renderer::EnqueueMeshLoad()
+{
+	//the load only gets what it works on, nothing of the renderer it could race with
+	Mesh* pLoadedMesh{ new Mesh() };
+	m_PendingMesh = m_pAssetLoader->Enqueue([filename = std::string{ "Resources/vehicle.obj" }, pLoadedMesh, optimizeMesh = m_OptimizeMeshOnLoad, quantizeVertices = m_UseQuantizedVertices]
+		{
+			ThreadPool loadThreadPool{ NR_MESH_LOAD_THREADS };
+			LoadMesh(filename, *pLoadedMesh, optimizeMesh, quantizeVertices, &loadThreadPool);
+			return pLoadedMesh;
+		});
+}
+
+void Renderer::LoadMesh(const std::string& filename, Mesh& mesh, bool optimizeMesh, bool quantizeVertices, ThreadPool* pThreadPool)
+{
+	const auto loadStart{ std::chrono::steady_clock::now() };
+
+	//The cache holds the mesh as it is at the end of this function, so it has to know which of the optional steps ran too
+	const uint32_t buildFlags{ optimizeMesh ? 1u : 0u };
+	const uint64_t sourceHash{ MeshCache::HashSourceFile(filename) };
+	const std::string cacheFilename{ filename + MeshCache::FILE_EXTENSION };
+
+	//how well the parser's deduplication did, printed the same way whichever path the mesh came from
+	const auto printVertexReuse{ [&filename, &mesh]()
+		{
+			std::cout << filename << ": " << mesh.vertices.size() << " vertices for " << mesh.indices.size() << " face corners ("
+				<< (mesh.vertices.empty() ? 0.0f : static_cast<float>(mesh.indices.size()) / mesh.vertices.size()) << "x reuse)\n";
+		} };
+
+	if (sourceHash != 0 and MeshCache::Load(cacheFilename, sourceHash, buildFlags, mesh))
+	{
+		printVertexReuse();
+		const std::chrono::duration<float, std::milli> loadTime{ std::chrono::steady_clock::now() - loadStart };
+		std::cout << filename << ": " << mesh.meshlets.size() << " meshlets loaded from " << cacheFilename << " in " << loadTime.count() << "ms\n";
+	}
+	else
+	{
+		if (!Utils::ParseOBJ(filename, mesh.vertices, mesh.indices, true, pThreadPool))
+		{
+			std::cout << filename << ": couldn't be parsed\n";
+			return;
+		}
+		printVertexReuse();
+
+		const uint32_t nrParsedVertices{ static_cast<uint32_t>(mesh.vertices.size()) };
+		const float acmrBefore{ MeshOptimizer::CalculateACMR(mesh.indices, nrParsedVertices) };
+		const float atvrBefore{ MeshOptimizer::CalculateATVR(mesh.indices, nrParsedVertices) };
+
+		//the whole mesh in cache order only gives the meshlets neighbouring triangles to grow over,
+		//BuildMeshlets reorders every triangle, so the order that gets rendered is made inside the meshlets afterwards
+		if (optimizeMesh)
+		{
+			MeshOptimizer::OptimizeVertexCache(mesh.indices, nrParsedVertices);
+		}
+
+		MeshOptimizer::BuildMeshlets(mesh.vertices, mesh.indices, mesh.meshletVertices, mesh.meshlets);
+
+		if (optimizeMesh)
+		{
+			MeshOptimizer::OptimizeMeshlets(mesh.vertices, mesh.indices, mesh.meshletVertices, mesh.meshlets);
+		}
+
+		//measured on the index buffer that is actually rendered
+		const uint32_t nrVertices{ static_cast<uint32_t>(mesh.vertices.size()) };
+		std::cout << filename << ": ACMR " << acmrBefore << " -> " << MeshOptimizer::CalculateACMR(mesh.indices, nrVertices)
+			<< ", ATVR " << atvrBefore << " -> " << MeshOptimizer::CalculateATVR(mesh.indices, nrVertices) << "\n";
+		std::cout << filename << ": " << mesh.meshlets.size() << " meshlets sharing " << mesh.vertices.size() << " vertices, " << mesh.meshletVertices.size() << " meshlet vertex entries\n";
+
+		mesh.CalculateBounds();
+
+		if (!MeshCache::Save(cacheFilename, sourceHash, buildFlags, mesh))
+		{
+			std::cout << filename << ": couldn't write " << cacheFilename << "\n";
+		}
+
+		const std::chrono::duration<float, std::milli> loadTime{ std::chrono::steady_clock::now() - loadStart };
+		std::cout << filename << ": parsed and processed in " << loadTime.count() << "ms\n";
+	}
+
+	mesh.primitiveTopology = PrimitiveTopology::TriangleList;
+	mesh.BuildVertexStreams(quantizeVertices);
+}
+
+void Renderer::UpdatePendingAssets()
+{
+	//the mesh doesn't keep the vertices its streams were built from, another layout means loading it again, mostly from the mesh cache
+	//an empty mesh looks the same in either layout
+	if (m_PendingMesh.valid() == false and m_Mesh->vertexStreams.nrVertices > 0 and m_Mesh->vertexStreams.isQuantized != m_UseQuantizedVertices)
+	{
+		m_LoadStart = std::chrono::steady_clock::now();
+		EnqueueMeshLoad();
+	}
+
+	if (m_PendingTextures.empty() and m_PendingMesh.valid() == false)
+	{
+		return;
+	}
+
+	for (size_t index{}; index < m_PendingTextures.size();)
+	{
+		PendingTexture& pendingTexture{ m_PendingTextures[index] };
+		if (AssetLoader::IsReady(pendingTexture.future) == false)
+		{
+			++index;
+			continue;
+		}
+
+		//a texture that failed to load keeps its placeholder
+		if (Texture* pTexture{ pendingTexture.future.get() })
+		{
+			delete *pendingTexture.ppTexture;
+			*pendingTexture.ppTexture = pTexture;
+			m_IsFrameDirty = true;
+		}
+		m_PendingTextures.erase(m_PendingTextures.begin() + index);
+	}
+
+	if (AssetLoader::IsReady(m_PendingMesh))
+	{
+		//the loaded mesh takes over the placeholder's transform, the vertex streams get built from it on the next render
+		Mesh* pMesh{ m_PendingMesh.get() };
+		pMesh->rotationTransform = m_Mesh->rotationTransform;
+		pMesh->translationTransform = m_Mesh->translationTransform;
+		pMesh->scaleTransform = m_Mesh->scaleTransform;
+		pMesh->isTransformDirty = true;
+
+		delete m_Mesh;
+		m_Mesh = pMesh;
+		m_AreVerticesDirty = true;
+		m_IsFrameDirty = true;
+	}
+
+	if (m_PendingTextures.empty() and m_PendingMesh.valid() == false)
+	{
+		const std::chrono::duration<float, std::milli> loadTime{ std::chrono::steady_clock::now() - m_LoadStart };
+		std::cout << "All assets loaded after " << loadTime.count() << "ms\n";
+	}
+}
+
 void Renderer::Update(Timer* pTimer)
 {
-	m_Camera.Update(pTimer);
+	UpdatePendingAssets();
 
-	std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, FLT_MAX);
-	std::fill_n(m_pBackBufferPixels, m_Width * m_Height, 0);
+	m_Camera.Update(pTimer);
 
 	if (m_IsRotating)
 	{
@@ -69,10 +250,36 @@ void Renderer::Update(Timer* pTimer)
 	}
 
 	m_Mesh->Update();
+
+	if (m_Camera.hasChanged or m_Mesh->hasChanged)
+	{
+		m_AreVerticesDirty = true;
+		m_IsFrameDirty = true;
+	}
+
+	//the buffers still hold the last frame, Render shows that one again
+	if (m_IsFrameDirty == false)
+	{
+		return;
+	}
+
+	std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, FLT_MAX);
+	std::fill_n(m_pVisibilityBufferPixels, m_Width * m_Height, NO_TRIANGLE);
+	std::fill(m_HiZMaxDepth.begin(), m_HiZMaxDepth.end(), FLT_MAX);
+	std::fill(m_TileMaxDepth.begin(), m_TileMaxDepth.end(), FLT_MAX);
+	std::fill_n(m_pBackBufferPixels, m_Width * m_Height, 0);
 }
 
 void Renderer::Render()
 {
+	m_IsIdle = (m_IsFrameDirty == false);
+	if (m_IsIdle)
+	{
+		SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
+		SDL_UpdateWindowSurface(m_pWindow);
+		return;
+	}
+
 	//@START
 	//Lock BackBuffer
 	SDL_LockSurface(m_pBackBuffer);
@@ -80,6 +287,7 @@ void Renderer::Render()
 	SDL_FillRect(m_pBackBuffer, NULL, SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100));
 
 	Render_W7();
+	m_IsFrameDirty = false;
 
 	//@END
 	//Update SDL Surface
@@ -88,30 +296,235 @@ void Renderer::Render()
 	SDL_UpdateWindowSurface(m_pWindow);
 }
 
-void Renderer::VertexTransformationFunction(const std::vector<Vertex>& vertices_in, std::vector<Vertex_Out>& vertices_out) const
+void Renderer::VertexTransformationFunction(const VertexStreams& vertices_in, VertexOutStreams& vertices_out)
 {
 	//Todo > W1 Projection Stage
-	Vertex_Out out{};
-	Vertex currentVertex{};
+	const Matrix finalMatrix = m_Mesh->worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix;
+
+	const int nrVertices{ vertices_in.nrVertices };
+
+	m_VertexClipFlags.resize(nrVertices);
+
+	//only vertices of meshlets that survived CullMeshlets are needed, marked per block of VERTEX_BLOCK_SIZE
+	//meshlets share their border vertices, so the work is split over blocks instead of meshlets and no two workers ever write the same vertex
+	if (m_Mesh->meshlets.empty() == false)
+	{
+		const int nrBlocks{ (nrVertices + VERTEX_BLOCK_SIZE - 1) / VERTEX_BLOCK_SIZE };
+		m_IsVertexBlockUsed.assign(nrBlocks, 0);
+		for (const uint32_t meshletIndex : m_VisibleMeshlets)
+		{
+			const Meshlet& meshlet{ m_Mesh->meshlets[meshletIndex] };
+			for (uint32_t meshletVertex{ meshlet.firstVertex }; meshletVertex < meshlet.firstVertex + meshlet.nrVertices; ++meshletVertex)
+			{
+				m_IsVertexBlockUsed[m_Mesh->meshletVertices[meshletVertex] / VERTEX_BLOCK_SIZE] = 1;
+			}
+		}
+
+		const uint32_t nrJobs{ (static_cast<uint32_t>(nrBlocks) + VERTEX_BLOCKS_PER_JOB - 1) / VERTEX_BLOCKS_PER_JOB };
+
+		m_pThreadPool->ParallelFor(nrJobs, [&](uint32_t jobIndex)
+			{
+				const int lastJobBlock{ std::min(static_cast<int>((jobIndex + 1) * VERTEX_BLOCKS_PER_JOB), nrBlocks) };
+				for (int block{ static_cast<int>(jobIndex * VERTEX_BLOCKS_PER_JOB) }; block < lastJobBlock; ++block)
+				{
+					if (m_IsVertexBlockUsed[block] == 0)
+					{
+						continue;
+					}
+
+					//a run of used blocks is transformed in one go
+					const int firstBlock{ block };
+					while (block + 1 < lastJobBlock and m_IsVertexBlockUsed[block + 1])
+					{
+						++block;
+					}
+					TransformVertexChunk(finalMatrix, firstBlock * VERTEX_BLOCK_SIZE, std::min((block + 1) * VERTEX_BLOCK_SIZE, nrVertices), vertices_in, vertices_out);
+				}
+			});
+	}
+	else
+	{
+		const uint32_t nrChunks{ static_cast<uint32_t>((nrVertices + VERTEX_CHUNK_SIZE - 1) / VERTEX_CHUNK_SIZE) };
+
+		//chunks never share a vertex, so every worker writes its own part of vertices_out and m_VertexClipFlags
+		m_pThreadPool->ParallelFor(nrChunks, [&](uint32_t chunkIndex)
+			{
+				const int firstChunkVertex{ static_cast<int>(chunkIndex) * VERTEX_CHUNK_SIZE };
+				TransformVertexChunk(finalMatrix, firstChunkVertex, std::min(firstChunkVertex + VERTEX_CHUNK_SIZE, nrVertices), vertices_in, vertices_out);
+			});
+	}
+
+	//positions stay in clip space, the perspective divide happens in ConvertToScreenSpace once clipping is done
+}
+
+void Renderer::TransformVertexChunk(const Matrix& finalMatrix, int firstChunkVertex, int lastChunkVertex, const VertexStreams& vertices_in, VertexOutStreams& vertices_out)
+{
+	static_assert(AVX2_VERTEX_BATCH_SIZE <= VertexStreams::STREAM_PADDING, "vertex streams aren't padded for a whole batch");
+
+	const Matrix& worldMatrix = m_Mesh->worldMatrix;
+
+	float finalElements[4][4]{};
+	float worldElements[3][3]{};
+	for (int row{}; row < 4; ++row)
+	{
+		for (int column{}; column < 4; ++column)
+		{
+			finalElements[row][column] = finalMatrix[row][column];
+			if (row < 3 and column < 3) worldElements[row][column] = worldMatrix[row][column];
+		}
+	}
+
+	if (m_IsAVX2Supported)
+	{
+		//only the layout that was built has data, the other pointers end up null
+		VertexStreamPointers streams_in{};
+		streams_in.isQuantized = vertices_in.isQuantized;
+		streams_in.pPositions[0] = vertices_in.positionX.data();
+		streams_in.pPositions[1] = vertices_in.positionY.data();
+		streams_in.pPositions[2] = vertices_in.positionZ.data();
+		streams_in.pNormals[0] = vertices_in.normalX.data();
+		streams_in.pNormals[1] = vertices_in.normalY.data();
+		streams_in.pNormals[2] = vertices_in.normalZ.data();
+		streams_in.pTangents[0] = vertices_in.tangentX.data();
+		streams_in.pTangents[1] = vertices_in.tangentY.data();
+		streams_in.pTangents[2] = vertices_in.tangentZ.data();
+
+		streams_in.pQuantizedPositions[0] = vertices_in.quantizedPositionX.data();
+		streams_in.pQuantizedPositions[1] = vertices_in.quantizedPositionY.data();
+		streams_in.pQuantizedPositions[2] = vertices_in.quantizedPositionZ.data();
+		streams_in.pQuantizedUVs[0] = vertices_in.quantizedU.data();
+		streams_in.pQuantizedUVs[1] = vertices_in.quantizedV.data();
+		streams_in.pOctahedralNormals[0] = vertices_in.octahedralNormalX.data();
+		streams_in.pOctahedralNormals[1] = vertices_in.octahedralNormalY.data();
+		streams_in.pOctahedralTangents[0] = vertices_in.octahedralTangentX.data();
+		streams_in.pOctahedralTangents[1] = vertices_in.octahedralTangentY.data();
+		streams_in.positionOffset[0] = vertices_in.positionOffset.x;
+		streams_in.positionOffset[1] = vertices_in.positionOffset.y;
+		streams_in.positionOffset[2] = vertices_in.positionOffset.z;
+		streams_in.positionScale[0] = vertices_in.positionScale.x;
+		streams_in.positionScale[1] = vertices_in.positionScale.y;
+		streams_in.positionScale[2] = vertices_in.positionScale.z;
+		streams_in.uvOffset[0] = vertices_in.uvOffset.x;
+		streams_in.uvOffset[1] = vertices_in.uvOffset.y;
+		streams_in.uvScale[0] = vertices_in.uvScale.x;
+		streams_in.uvScale[1] = vertices_in.uvScale.y;
+
+		TransformVertexChunkAVX2(finalElements, worldElements, firstChunkVertex, lastChunkVertex, streams_in, vertices_in, vertices_out);
+		return;
+	}
+
+	//every matrix element splatted over a register, [row][column]
+	__m128 finalSplats[4][4]{};
+	__m128 worldSplats[3][3]{};
+	for (int row{}; row < 4; ++row)
+	{
+		for (int column{}; column < 4; ++column)
+		{
+			finalSplats[row][column] = _mm_set1_ps(finalElements[row][column]);
+			if (row < 3 and column < 3) worldSplats[row][column] = _mm_set1_ps(worldElements[row][column]);
+		}
+	}
+
+	//Decoding of the quantized streams, see VertexStreams
+	//SSE2 has no widening loads, so the 16 bit values are unpacked into the top half of every lane and shifted down
+	const __m128 positionScale[3]{ _mm_set1_ps(vertices_in.positionScale.x), _mm_set1_ps(vertices_in.positionScale.y), _mm_set1_ps(vertices_in.positionScale.z) };
+	const __m128 positionOffset[3]{ _mm_set1_ps(vertices_in.positionOffset.x), _mm_set1_ps(vertices_in.positionOffset.y), _mm_set1_ps(vertices_in.positionOffset.z) };
+	const __m128 uvScale[2]{ _mm_set1_ps(vertices_in.uvScale.x), _mm_set1_ps(vertices_in.uvScale.y) };
+	const __m128 uvOffset[2]{ _mm_set1_ps(vertices_in.uvOffset.x), _mm_set1_ps(vertices_in.uvOffset.y) };
+
+	const auto decodeUnorm16{ [](const uint16_t* pValues, __m128 scale, __m128 offset)
+		{
+			const __m128i packed{ _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pValues)) };
+			const __m128 values{ _mm_cvtepi32_ps(_mm_srli_epi32(_mm_unpacklo_epi16(packed, packed), 16)) };
+			return _mm_add_ps(_mm_mul_ps(values, scale), offset);
+		} };
+	const auto decodeSnorm16{ [](const int16_t* pValues)
+		{
+			const __m128i packed{ _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pValues)) };
+			const __m128 values{ _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16)) };
+			return _mm_max_ps(_mm_mul_ps(values, _mm_set1_ps(1.0f / VertexStreams::SNORM16_MAX)), _mm_set1_ps(-1.0f));
+		} };
+	//z is what's left of the manhattan length, the corners folded over for negative z are unfolded by moving x and y back towards the center
+	const auto decodeOctahedral{ [&](const int16_t* pOctahedralX, const int16_t* pOctahedralY, __m128& x, __m128& y, __m128& z)
+		{
+			const __m128 signMask{ _mm_set1_ps(-0.0f) };
+			const __m128 octahedralX{ decodeSnorm16(pOctahedralX) };
+			const __m128 octahedralY{ decodeSnorm16(pOctahedralY) };
+
+			z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_andnot_ps(signMask, octahedralX)), _mm_andnot_ps(signMask, octahedralY));
+			const __m128 fold{ _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps()) };
+			x = _mm_sub_ps(octahedralX, _mm_or_ps(fold, _mm_and_ps(octahedralX, signMask)));
+			y = _mm_sub_ps(octahedralY, _mm_or_ps(fold, _mm_and_ps(octahedralY, signMask)));
 
-	Matrix finalMatrix = m_Mesh->worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix;
+			const __m128 inverseLength{ _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)))) };
+			x = _mm_mul_ps(x, inverseLength);
+			y = _mm_mul_ps(y, inverseLength);
+			z = _mm_mul_ps(z, inverseLength);
+		} };
 
-	for (int index = 0; index < vertices_in.size(); index++)
+	VertexBatch batch{};
+
+	for (int firstVertex{ firstChunkVertex }; firstVertex < lastChunkVertex; firstVertex += SSE_VERTEX_BATCH_SIZE)
 	{
-		currentVertex = vertices_in[index];
+		//same products and sums, in the same order, as Matrix::TransformPoint and Matrix::TransformVector
+		__m128 x{}, y{}, z{}, nx{}, ny{}, nz{}, tx{}, ty{}, tz{};
+		if (vertices_in.isQuantized)
+		{
+			x = decodeUnorm16(&vertices_in.quantizedPositionX[firstVertex], positionScale[0], positionOffset[0]);
+			y = decodeUnorm16(&vertices_in.quantizedPositionY[firstVertex], positionScale[1], positionOffset[1]);
+			z = decodeUnorm16(&vertices_in.quantizedPositionZ[firstVertex], positionScale[2], positionOffset[2]);
+			decodeOctahedral(&vertices_in.octahedralNormalX[firstVertex], &vertices_in.octahedralNormalY[firstVertex], nx, ny, nz);
+			decodeOctahedral(&vertices_in.octahedralTangentX[firstVertex], &vertices_in.octahedralTangentY[firstVertex], tx, ty, tz);
+			_mm_store_ps(batch.uvs[0], decodeUnorm16(&vertices_in.quantizedU[firstVertex], uvScale[0], uvOffset[0]));
+			_mm_store_ps(batch.uvs[1], decodeUnorm16(&vertices_in.quantizedV[firstVertex], uvScale[1], uvOffset[1]));
+		}
+		else
+		{
+			x = _mm_loadu_ps(&vertices_in.positionX[firstVertex]);
+			y = _mm_loadu_ps(&vertices_in.positionY[firstVertex]);
+			z = _mm_loadu_ps(&vertices_in.positionZ[firstVertex]);
+			nx = _mm_loadu_ps(&vertices_in.normalX[firstVertex]);
+			ny = _mm_loadu_ps(&vertices_in.normalY[firstVertex]);
+			nz = _mm_loadu_ps(&vertices_in.normalZ[firstVertex]);
+			tx = _mm_loadu_ps(&vertices_in.tangentX[firstVertex]);
+			ty = _mm_loadu_ps(&vertices_in.tangentY[firstVertex]);
+			tz = _mm_loadu_ps(&vertices_in.tangentZ[firstVertex]);
+		}
+
+		for (int column{}; column < 4; ++column)
+		{
+			const __m128 result{ _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(finalSplats[0][column], x), _mm_mul_ps(finalSplats[1][column], y)),
+				_mm_mul_ps(finalSplats[2][column], z)), finalSplats[3][column]) };
+			_mm_store_ps(batch.positions[column], result);
+		}
+
+		for (int column{}; column < 3; ++column)
+		{
+			_mm_store_ps(batch.normals[column], _mm_add_ps(_mm_add_ps(_mm_mul_ps(worldSplats[0][column], nx), _mm_mul_ps(worldSplats[1][column], ny)),
+				_mm_mul_ps(worldSplats[2][column], nz)));
+			_mm_store_ps(batch.tangents[column], _mm_add_ps(_mm_add_ps(_mm_mul_ps(worldSplats[0][column], tx), _mm_mul_ps(worldSplats[1][column], ty)),
+				_mm_mul_ps(worldSplats[2][column], tz)));
+		}
+
+		StoreVertexBatch(batch, firstVertex, std::min(SSE_VERTEX_BATCH_SIZE, lastChunkVertex - firstVertex), vertices_in, vertices_out);
+	}
+}
 
-		out.color			= currentVertex.color;
-		out.uv				= currentVertex.uv;
-		out.position		= finalMatrix.TransformPoint(currentVertex.position.ToPoint4());
-		out.normal			= m_Mesh->worldMatrix.TransformVector(currentVertex.normal.ToVector4());
-		out.tangent			= m_Mesh->worldMatrix.TransformVector(currentVertex.tangent.ToVector4());
-		out.viewDirection	= out.position - m_Camera.origin.ToPoint4();
+void Renderer::StoreVertexBatch(const VertexBatch& batch, int firstVertex, int nrLanes, const VertexStreams& vertices_in, VertexOutStreams& vertices_out)
+{
+	//the output streams hold whole vectors, so the components are put back together per vertex
+	for (int lane{}; lane < nrLanes; ++lane)
+	{
+		const int index{ firstVertex + lane };
+		const Vector4 outPosition{ batch.positions[0][lane], batch.positions[1][lane], batch.positions[2][lane], batch.positions[3][lane] };
 
-		out.position.x /= out.position.w;
-		out.position.y /= out.position.w;
-		out.position.z /= out.position.w;
+		vertices_out.positions[index]		= outPosition;
+		vertices_out.uvs[index]				= vertices_in.isQuantized ? Vector2{ batch.uvs[0][lane], batch.uvs[1][lane] } : vertices_in.uvs[index];
+		vertices_out.normals[index]			= Vector3{ batch.normals[0][lane], batch.normals[1][lane], batch.normals[2][lane] };
+		vertices_out.tangents[index]		= Vector3{ batch.tangents[0][lane], batch.tangents[1][lane], batch.tangents[2][lane] };
+		vertices_out.viewDirections[index]	= Vector3{ outPosition.x - m_Camera.origin.x, outPosition.y - m_Camera.origin.y, outPosition.z - m_Camera.origin.z };
 
-		vertices_out[index] = out;
+		m_VertexClipFlags[index] = GetClipFlags(outPosition);
 	}
 }
 
@@ -152,54 +565,43 @@ void Renderer::InitializeTriangles(std::vector<Vertex>& verticesNDC, std::vector
 
 #pragma endregion
 
-	m_Mesh->vertices_out.resize(m_Mesh->indices.size());
+	m_Mesh->vertices_out.Resize(m_Mesh->indices.size());
 }
 
 void Renderer::Render_W7()
 {
-	float		interpolatedZ	{};
-	float		interpolatedW	{};
-	float		totalWeight		{};
-	Vector2		pixel			{};
-	Vector2		interpolatedUV	{};
-	ColorRGB	finalColor		{};
-	int swapOddVertices1		{};
-	int swapOddVertices2		{};
-	int pixelIndex				{};
-
-	std::vector<float> vertices_weights{};
-	vertices_weights.resize(m_Mesh->indices.size());
-	
-	VertexTransformationFunction(m_Mesh->vertices, m_Mesh->vertices_out);
+	//nothing of the mesh can end up on screen, so none of its vertices or triangles are touched
+	if (IsMeshInFrustum() == false)
+	{
+		++m_NrCulledMeshFrames;
+		++m_NrStatsFrames;
+		return;
+	}
 
-	//RENDER LOGIC
-	switch (m_Mesh->primitiveTopology)
+	//clip space results of the last transform are still valid when neither the camera nor the mesh moved
+	if (m_AreVerticesDirty)
 	{
-	case PrimitiveTopology::TriangleList:
-		for (int vertexIndex{}; vertexIndex < m_Mesh->indices.size(); vertexIndex+=3)
-		{
-			if (CheckCulling(vertexIndex))
-			{
-				continue;
-			}
+		CullMeshlets();
 
-			ConvertToScreenSpace(vertexIndex);
-			RenderList(vertexIndex, interpolatedZ, interpolatedW, totalWeight, pixel, interpolatedUV, finalColor, swapOddVertices1, swapOddVertices2, pixelIndex, vertices_weights);
-		}
-		break;
-	case PrimitiveTopology::TriangleStrip:
-		for (int vertexIndex{}; vertexIndex < (m_Mesh->indices.size() - 2); vertexIndex++)
+		VertexTransformationFunction(m_Mesh->vertexStreams, m_Mesh->vertices_out);
+		m_AreVerticesDirty = false;
+	}
+
+	BinTriangles();
+
+	//Every tile only touches its own pixels, so the workers can write color and depth without locking
+	m_pThreadPool->ParallelFor(static_cast<uint32_t>(m_TileBins.size()), [this](uint32_t tileIndex)
 		{
-			if (CheckCulling(vertexIndex))
-			{
-				continue;
-			}
+			RenderTile(tileIndex);
+		});
 
-			ConvertToScreenSpace(vertexIndex);
-			RenderStrip(vertexIndex, interpolatedZ, interpolatedW, totalWeight, pixel, interpolatedUV, finalColor, swapOddVertices1, swapOddVertices2, pixelIndex, vertices_weights, true);
-		}
-		break;
+	for (TileStats& tileStats : m_TileStats)
+	{
+		m_NrShadedPixels += tileStats.nrShadedPixels;
+		m_NrCoveredPixels += tileStats.nrCoveredPixels;
+		tileStats = {};
 	}
+	++m_NrStatsFrames;
 
 	for (int i = 0; i < m_Mesh->isVertex_outInScreenSpace.size(); i++)
 	{
@@ -207,198 +609,1167 @@ void Renderer::Render_W7()
 	}
 }
 
-void Renderer::RenderList(int vertexIndex, float interpolatedZ, float interpolatedW, float totalWeight, Vector2& pixel, Vector2& interpolatedUV, ColorRGB& finalColor, int swapOddVertices1, int swapOddVertices2, int pixelIndex, std::vector<float>& vertices_weights)
+void Renderer::CalculateFrustumPlanes(const Matrix& matrix, Vector4 planes[NR_FRUSTUM_PLANES]) const
 {
-	RenderStrip(vertexIndex, interpolatedZ, interpolatedW, totalWeight, pixel, interpolatedUV, finalColor, swapOddVertices1, swapOddVertices2, pixelIndex, vertices_weights, false);
+	//clip space is inside where -w <= x <= w, -w <= y <= w and 0 <= z <= w, every one of those is a plane in the matrix's input space
+	const Vector4 columns[4]{
+		{ matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0] },
+		{ matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1] },
+		{ matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2] },
+		{ matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3] } };
+
+	planes[0] = columns[3] + columns[0];
+	planes[1] = columns[3] - columns[0];
+	planes[2] = columns[3] + columns[1];
+	planes[3] = columns[3] - columns[1];
+	planes[4] = columns[2];
+	planes[5] = columns[3] - columns[2];
+
+	//normalized so plugging in a point gives its distance to the plane
+	for (int planeIndex{}; planeIndex < NR_FRUSTUM_PLANES; ++planeIndex)
+	{
+		Vector4& plane{ planes[planeIndex] };
+		const float inverseLength{ 1.0f / Vector3{ plane.x, plane.y, plane.z }.Magnitude() };
+		plane = { plane.x * inverseLength, plane.y * inverseLength, plane.z * inverseLength, plane.w * inverseLength };
+	}
 }
 
-void Renderer::RenderStrip(int vertexIndex, float interpolatedZ, float interpolatedW, float totalWeight, Vector2& pixel, Vector2& interpolatedUV, ColorRGB& finalColor, int swapOddVertices1, int swapOddVertices2, int pixelIndex, std::vector<float>& vertices_weights, bool isStrip = true)
+bool Renderer::IsMeshInFrustum() const
 {
-	int minX{}, maxX{}, minY{}, maxY{};
-	
-	CalculateBoundingBox(minX, maxX, minY, maxY, vertexIndex);
+	Vector4 frustumPlanes[NR_FRUSTUM_PLANES]{};
+	CalculateFrustumPlanes(m_Camera.viewMatrix * m_Camera.projectionMatrix, frustumPlanes);
+
+	const Vector3& boundsMin{ m_Mesh->worldBoundsMin };
+	const Vector3& boundsMax{ m_Mesh->worldBoundsMax };
 
-	//these are used to swap the orientation of triangles in the strip to all face the correct side
-	//if these are not used and + 1 or + 2 is written istead, that should mean that the order/position of the numbers doesn't really matter
-	//+ 0 is written purely for clarity
-	if (vertexIndex & 1 and isStrip)
+	//the box is outside as soon as its corner furthest along a plane's normal is still behind that plane
+	for (const Vector4& plane : frustumPlanes)
 	{
-		swapOddVertices1 = 1;
-		swapOddVertices2 = 2;
+		const Vector3 furthestCorner{
+			(plane.x >= 0.0f) ? boundsMax.x : boundsMin.x,
+			(plane.y >= 0.0f) ? boundsMax.y : boundsMin.y,
+			(plane.z >= 0.0f) ? boundsMax.z : boundsMin.z };
+
+		if ((plane.x * furthestCorner.x) + (plane.y * furthestCorner.y) + (plane.z * furthestCorner.z) + plane.w < 0.0f)
+		{
+			return false;
+		}
 	}
-	else
+
+	return true;
+}
+
+void Renderer::CullMeshlets()
+{
+	m_VisibleMeshlets.clear();
+
+	const uint32_t nrMeshlets{ static_cast<uint32_t>(m_Mesh->meshlets.size()) };
+	if (nrMeshlets == 0)
 	{
-		swapOddVertices1 = 2;
-		swapOddVertices2 = 1;
+		return;
 	}
 
-	for (int px{ minX }; px < maxX; ++px)
+	if (m_UseMeshletCulling == false)
 	{
-		for (int py{ minY }; py < maxY; ++py)
+		for (uint32_t meshletIndex{}; meshletIndex < nrMeshlets; ++meshletIndex)
 		{
-			if (m_ShowBoundingBox == false)
-			{
-				finalColor = ColorRGB(0.0f, 0.0f, 0.0f);
-				pixel = Vector2(px + 0.5f, py + 0.5f);
-				pixelIndex = px + (py * m_Width);
-
-				if (m_pDepthBufferPixels[pixelIndex] > m_Mesh->vertices_out[vertexIndex].position.z)
-				{
-					//initial weight calculation
-					vertices_weights[vertexIndex + 0] = Vector2::Cross(m_Mesh->vertices_out[vertexIndex + swapOddVertices1].position.GetXY() - m_Mesh->vertices_out[vertexIndex + 0].position.GetXY(), pixel - m_Mesh->vertices_out[vertexIndex + 0].position.GetXY());
-					vertices_weights[vertexIndex + swapOddVertices1] = Vector2::Cross(m_Mesh->vertices_out[vertexIndex + swapOddVertices2].position.GetXY() - m_Mesh->vertices_out[vertexIndex + swapOddVertices1].position.GetXY(), pixel - m_Mesh->vertices_out[vertexIndex + swapOddVertices1].position.GetXY());
-					vertices_weights[vertexIndex + swapOddVertices2] = Vector2::Cross(m_Mesh->vertices_out[vertexIndex + 0].position.GetXY() - m_Mesh->vertices_out[vertexIndex + swapOddVertices2].position.GetXY(), pixel - m_Mesh->vertices_out[vertexIndex + swapOddVertices2].position.GetXY());
+			m_VisibleMeshlets.push_back(meshletIndex);
+		}
+		m_NrVisibleMeshlets += nrMeshlets;
+		return;
+	}
 
-					if (vertices_weights[vertexIndex + 0] < 0 or vertices_weights[vertexIndex + 1] < 0 or vertices_weights[vertexIndex + 2] < 0) continue;
+	//planes of the combined matrix are in object space, like the meshlet bounds
+	Vector4 frustumPlanes[NR_FRUSTUM_PLANES]{};
+	CalculateFrustumPlanes(m_Mesh->worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix, frustumPlanes);
 
-					//normalize weights and calculate total weight
-					totalWeight = vertices_weights[vertexIndex + 0] +
-						vertices_weights[vertexIndex + 1] +
-						vertices_weights[vertexIndex + 2];
+	//the cones are tested in world space, the radius grows with the largest scale of the world matrix
+	const Matrix& worldMatrix = m_Mesh->worldMatrix;
+	const float worldScale{ std::max({ worldMatrix.GetAxisX().Magnitude(), worldMatrix.GetAxisY().Magnitude(), worldMatrix.GetAxisZ().Magnitude() }) };
 
-					vertices_weights[vertexIndex + 0] /= totalWeight;
-					vertices_weights[vertexIndex + swapOddVertices1] /= totalWeight;
-					vertices_weights[vertexIndex + swapOddVertices2] /= totalWeight;
+	for (uint32_t meshletIndex{}; meshletIndex < nrMeshlets; ++meshletIndex)
+	{
+		const Meshlet& meshlet{ m_Mesh->meshlets[meshletIndex] };
 
-					totalWeight = vertices_weights[vertexIndex + 0] +
-						vertices_weights[vertexIndex + 1] +
-						vertices_weights[vertexIndex + 2];
+		bool isOffScreen{ false };
+		for (const Vector4& plane : frustumPlanes)
+		{
+			if ((plane.x * meshlet.center.x) + (plane.y * meshlet.center.y) + (plane.z * meshlet.center.z) + plane.w < -meshlet.radius)
+			{
+				isOffScreen = true;
+				break;
+			}
+		}
 
-					interpolatedZ = 1 / ((vertices_weights[vertexIndex + 0] / m_Mesh->vertices_out[vertexIndex + swapOddVertices2].position.z) +
-						(vertices_weights[vertexIndex + swapOddVertices1] / m_Mesh->vertices_out[vertexIndex + 0].position.z) +
-						(vertices_weights[vertexIndex + swapOddVertices2] / m_Mesh->vertices_out[vertexIndex + swapOddVertices1].position.z));
+		if (isOffScreen)
+		{
+			++m_NrOffScreenMeshlets;
+			continue;
+		}
 
-					interpolatedW = 1 / ((vertices_weights[vertexIndex + 0] / m_Mesh->vertices_out[vertexIndex + swapOddVertices2].position.w) +
-						(vertices_weights[vertexIndex + swapOddVertices1] / m_Mesh->vertices_out[vertexIndex + 0].position.w) +
-						(vertices_weights[vertexIndex + swapOddVertices2] / m_Mesh->vertices_out[vertexIndex + swapOddVertices1].position.w));
+		//a triangle faces away when the camera sits behind its plane; for every point in the sphere and every normal in the cone
+		//that holds as soon as the view direction to the center is within 90 degrees minus the cone angle of the axis,
+		//with the sphere's radius as margin on both the dot product and the distance
+		//culling front faces is the same test with the cone turned around
+		if (meshlet.isConeValid and m_CullMode != CullMode::None)
+		{
+			const Vector3 toCenter{ worldMatrix.TransformPoint(meshlet.center) - m_Camera.origin };
+			const Vector3 coneAxis{ worldMatrix.TransformVector((m_CullMode == CullMode::Back) ? meshlet.coneAxis : -meshlet.coneAxis).Normalized() };
+			const float radius{ meshlet.radius * worldScale };
 
-					if (m_pDepthBufferPixels[pixelIndex] < interpolatedZ)
-					{
-						continue;
-					}
+			if (Vector3::Dot(toCenter, coneAxis) >= (meshlet.coneSine * toCenter.Magnitude()) + (radius * (1.0f + meshlet.coneSine)))
+			{
+				++m_NrFaceCulledMeshlets;
+				continue;
+			}
+		}
 
-					m_pDepthBufferPixels[pixelIndex] = interpolatedZ;
+		m_VisibleMeshlets.push_back(meshletIndex);
+		++m_NrVisibleMeshlets;
+	}
+}
 
-					interpolatedUV = (((m_Mesh->vertices_out[vertexIndex + 0].uv / m_Mesh->vertices_out[vertexIndex + 0].position.w) * vertices_weights[vertexIndex + swapOddVertices1]) +
-						((m_Mesh->vertices_out[vertexIndex + swapOddVertices1].uv / m_Mesh->vertices_out[vertexIndex + swapOddVertices1].position.w) * vertices_weights[vertexIndex + swapOddVertices2]) +
-						((m_Mesh->vertices_out[vertexIndex + swapOddVertices2].uv / m_Mesh->vertices_out[vertexIndex + swapOddVertices2].position.w) * vertices_weights[vertexIndex + 0])) * interpolatedW;
+void Renderer::BinTriangles()
+{
+	for (std::vector<uint32_t>& tileBin : m_TileBins)
+	{
+		tileBin.clear();
+	}
+	m_ScreenTriangles.clear();
 
-					float remap{ DepthRemap(interpolatedZ, 0.9975f, 1.0f) };
-					finalColor = ColorRGB(remap, remap, remap);
+	//drop the vertices that clipping added last frame
+	m_Mesh->vertices_out.Resize(m_Mesh->vertexStreams.nrVertices);
+	m_Mesh->isVertex_outInScreenSpace.resize(m_Mesh->vertexStreams.nrVertices);
 
-					Vertex_Out vertexToShade{};
-					vertexToShade.position.x = static_cast<float>(px);
-					vertexToShade.position.y = static_cast<float>(py);
-					vertexToShade.position.z = interpolatedZ;
-					vertexToShade.position.w = interpolatedW;
-					vertexToShade.color = finalColor;
-					vertexToShade.uv = interpolatedUV;
-					vertexToShade.normal = ((m_Mesh->vertices_out[vertexIndex + 0].normal * vertices_weights[vertexIndex + swapOddVertices1]) +
-						(m_Mesh->vertices_out[vertexIndex + swapOddVertices1].normal * vertices_weights[vertexIndex + swapOddVertices2]) +
-						(m_Mesh->vertices_out[vertexIndex + swapOddVertices2].normal * vertices_weights[vertexIndex + 0])) / 3;
+	const bool isStrip{ m_Mesh->primitiveTopology == PrimitiveTopology::TriangleStrip };
+	const int vertexStep{ isStrip ? 1 : 3 };
 
+	//first pass works on clip space positions: cull, and clip whatever crosses the near/far plane or leaves the guard band
+	//nothing is converted to screen space yet, so strips can still share vertices between a clipped and an unclipped triangle
+	//meshes with meshlets only go over the triangles of the meshlets that are left after CullMeshlets
+	const bool hasMeshlets{ m_Mesh->meshlets.empty() == false };
+	const size_t nrIndexRanges{ hasMeshlets ? m_VisibleMeshlets.size() : 1 };
 
-					vertexToShade.tangent = ((m_Mesh->vertices_out[vertexIndex + 0].tangent * vertices_weights[vertexIndex + swapOddVertices1]) +
-						(m_Mesh->vertices_out[vertexIndex + swapOddVertices1].tangent * vertices_weights[vertexIndex + swapOddVertices2]) +
-						(m_Mesh->vertices_out[vertexIndex + swapOddVertices2].tangent * vertices_weights[vertexIndex + 0])) / 3;
+	for (size_t indexRange{}; indexRange < nrIndexRanges; ++indexRange)
+	{
+		int firstIndex{ 0 };
+		int lastIndex{ static_cast<int>(m_Mesh->indices.size()) };
+		if (hasMeshlets)
+		{
+			const Meshlet& meshlet{ m_Mesh->meshlets[m_VisibleMeshlets[indexRange]] };
+			firstIndex = static_cast<int>(meshlet.firstIndex);
+			lastIndex = firstIndex + static_cast<int>(meshlet.nrTriangles * 3);
+		}
 
-					vertexToShade.viewDirection = ((m_Mesh->vertices_out[vertexIndex + 0].viewDirection * vertices_weights[vertexIndex + swapOddVertices1]) +
-						(m_Mesh->vertices_out[vertexIndex + swapOddVertices1].viewDirection * vertices_weights[vertexIndex + swapOddVertices2]) +
-						(m_Mesh->vertices_out[vertexIndex + swapOddVertices2].viewDirection * vertices_weights[vertexIndex + 0])) / 3;
-					vertexToShade.viewDirection.Normalize();
+		for (int index{ firstIndex }; index + 2 < lastIndex; index += vertexStep)
+		{
+			//these are used to swap the orientation of triangles in the strip to all face the correct side
+			//lists are used as they are, ParseOBJ already wrote them in the winding we rasterize with
+			const int swapOddVertices1{ (index & 1 and isStrip) ? 2 : 1 };
+			const int swapOddVertices2{ 3 - swapOddVertices1 };
 
-					finalColor = PixelShading(vertexToShade);
+			ScreenTriangle triangle{};
+			triangle.vertexIndices[0] = m_Mesh->indices[index + 0];
+			triangle.vertexIndices[1] = m_Mesh->indices[index + swapOddVertices1];
+			triangle.vertexIndices[2] = m_Mesh->indices[index + swapOddVertices2];
 
-					//Update Color in Buffer
-					finalColor.MaxToOne();
-					//finalColor.ToneMap();
+			if (CheckCulling(triangle.vertexIndices))
+			{
+				continue;
+			}
 
-					m_pBackBufferPixels[pixelIndex] = SDL_MapRGB(m_pBackBuffer->format,
-						static_cast<uint8_t>(finalColor.r * 255),
-						static_cast<uint8_t>(finalColor.g * 255),
-						static_cast<uint8_t>(finalColor.b * 255));
-				}
+			//the edge functions only cover triangles with a positive area on screen,
+			//so back faces that are kept get their winding turned around here instead of failing every pixel later
+			const bool isFrontFacing{ GetClipSpaceDeterminant(triangle.vertexIndices) < 0.0f };
+			if ((m_CullMode == CullMode::Back and isFrontFacing == false) or (m_CullMode == CullMode::Front and isFrontFacing))
+			{
+				continue;
 			}
-			else
+
+			if (isFrontFacing == false)
 			{
-				pixelIndex = px + (py * m_Width);
+				std::swap(triangle.vertexIndices[1], triangle.vertexIndices[2]);
+			}
 
-				finalColor = colors::White;
+			const uint8_t clipFlags{ static_cast<uint8_t>(m_VertexClipFlags[triangle.vertexIndices[0]] |
+				m_VertexClipFlags[triangle.vertexIndices[1]] |
+				m_VertexClipFlags[triangle.vertexIndices[2]]) };
 
-				m_pBackBufferPixels[pixelIndex] = SDL_MapRGB(m_pBackBuffer->format,
-					static_cast<uint8_t>(finalColor.r * 255),
-					static_cast<uint8_t>(finalColor.g * 255),
-					static_cast<uint8_t>(finalColor.b * 255));
+			if (clipFlags & (ClipNear | ClipFar | ClipGuardBand))
+			{
+				ClipTriangle(triangle.vertexIndices, clipFlags);
+				continue;
 			}
+
+			m_ScreenTriangles.push_back(triangle);
 		}
 	}
-}
 
-bool Renderer::CheckCulling(const int vertexIndex)
-{
-	const int frustumOffset{ 1 };
-
-	//check for frustum
-	for (int i = 0; i < 3; i++)
+	//second pass goes to screen space, sets up and bins the triangles that are left
+	uint32_t nrVisibleTriangles{};
+	for (ScreenTriangle triangle : m_ScreenTriangles)
 	{
-		if (m_Mesh->isVertex_outInScreenSpace[vertexIndex + i] == false)
+		ConvertToScreenSpace(triangle.vertexIndices);
+
+		CalculateBoundingBox(triangle.minX, triangle.maxX, triangle.minY, triangle.maxY, triangle.vertexIndices);
+
+		//doesn't cover a single pixel center on screen
+		if (triangle.minX >= triangle.maxX or triangle.minY >= triangle.maxY)
 		{
-			if (m_Mesh->vertices_out[vertexIndex + i].position.x < -frustumOffset or m_Mesh->vertices_out[vertexIndex + i].position.x > frustumOffset or
-				m_Mesh->vertices_out[vertexIndex + i].position.y < -frustumOffset or m_Mesh->vertices_out[vertexIndex + i].position.y > frustumOffset or
-				m_Mesh->vertices_out[vertexIndex + i].position.z < 0			  or m_Mesh->vertices_out[vertexIndex + i].position.z > frustumOffset)
-			{
-				return true;
-			}
+			continue;
+		}
+
+		if (SetupTriangle(triangle) == false)
+		{
+			continue;
 		}
+
+		const uint32_t triangleIndex{ nrVisibleTriangles++ };
+		triangle.id = triangleIndex;
+		m_ScreenTriangles[triangleIndex] = triangle;
 	}
+	m_ScreenTriangles.resize(nrVisibleTriangles);
 
-	if (m_Mesh->vertices_out[vertexIndex].position.w < 0 or m_Mesh->vertices_out[vertexIndex + 1].position.w < 0 or m_Mesh->vertices_out[vertexIndex + 2].position.w < 0)
+	if (m_SortFrontToBack)
 	{
-		return true;
+		SortTrianglesFrontToBack();
 	}
-
-	//check if 2 vertices in triangle are the same => not a triangle => skip
-	if (m_Mesh->indices[vertexIndex + 0] == m_Mesh->indices[vertexIndex + 1] or 
-		m_Mesh->indices[vertexIndex + 0] == m_Mesh->indices[vertexIndex + 2] or 
-		m_Mesh->indices[vertexIndex + 1] == m_Mesh->indices[vertexIndex + 2])
+	else
 	{
-		return true;
+		m_TriangleOrder.resize(nrVisibleTriangles);
+		for (uint32_t index{}; index < nrVisibleTriangles; ++index)
+		{
+			m_TriangleOrder[index] = index;
+		}
 	}
-	
-	return false;
-}
-
-void Renderer::CalculateBoundingBox(int& minX, int& maxX, int& minY, int& maxY, const int vertexIndex)
-{
-	minX = int(std::min({ m_Mesh->vertices_out[vertexIndex + 0].position.x, m_Mesh->vertices_out[vertexIndex + 1].position.x, m_Mesh->vertices_out[vertexIndex + 2].position.x }));
-	minY = int(std::min({ m_Mesh->vertices_out[vertexIndex + 0].position.y, m_Mesh->vertices_out[vertexIndex + 1].position.y, m_Mesh->vertices_out[vertexIndex + 2].position.y }));
-	maxX = int(std::max({ m_Mesh->vertices_out[vertexIndex + 0].position.x, m_Mesh->vertices_out[vertexIndex + 1].position.x, m_Mesh->vertices_out[vertexIndex + 2].position.x }));
-	maxY = int(std::max({ m_Mesh->vertices_out[vertexIndex + 0].position.y, m_Mesh->vertices_out[vertexIndex + 1].position.y, m_Mesh->vertices_out[vertexIndex + 2].position.y }));
 
-	int offset{ 1 };
-	minX = std::clamp(minX, offset, m_Width - offset)  - offset;
-	maxX = std::clamp(maxX, offset, m_Width - offset)  + offset;
-	minY = std::clamp(minY, offset, m_Height - offset) - offset;
-	maxY = std::clamp(maxY, offset, m_Height - offset) + offset;
+	//tiles process their bin in order, so whatever order the triangles are binned in is the order they get drawn in
+	for (const uint32_t triangleIndex : m_TriangleOrder)
+	{
+		const ScreenTriangle& triangle{ m_ScreenTriangles[triangleIndex] };
 
-}
+		//the bounding box max is exclusive
+		const int firstTileX{ triangle.minX / TILE_SIZE };
+		const int firstTileY{ triangle.minY / TILE_SIZE };
+		const int lastTileX{ (triangle.maxX - 1) / TILE_SIZE };
+		const int lastTileY{ (triangle.maxY - 1) / TILE_SIZE };
 
-void Renderer::ConvertToScreenSpace(const int vertexIndex)
-{
-	for (int i = 0; i < 3; i++)
-	{
-		if (m_Mesh->isVertex_outInScreenSpace[vertexIndex + i] == false)
+		for (int tileY{ firstTileY }; tileY <= lastTileY; ++tileY)
 		{
-			m_Mesh->vertices_out[vertexIndex + i].position.x = ((m_Mesh->vertices_out[vertexIndex + i].position.x + 1) / 2) * float(m_Width);
-			m_Mesh->vertices_out[vertexIndex + i].position.y = ((1 - m_Mesh->vertices_out[vertexIndex + i].position.y) / 2) * float(m_Height);
-			m_Mesh->isVertex_outInScreenSpace[vertexIndex + i] = true;
+			for (int tileX{ firstTileX }; tileX <= lastTileX; ++tileX)
+			{
+				m_TileBins[tileX + (tileY * m_NrTilesX)].push_back(triangleIndex);
+			}
 		}
 	}
 }
 
-float Renderer::DepthRemap(const float value, const float fromMin, const float fromMax)
+void Renderer::SortTrianglesFrontToBack()
 {
-	float normalizedValue{ (value - fromMin) / (fromMax - fromMin) };
+	const uint32_t nrTriangles{ static_cast<uint32_t>(m_ScreenTriangles.size()) };
+
+	m_TriangleOrder.resize(nrTriangles);
+	m_SortScratch.resize(nrTriangles);
+	m_SortKeys.resize(nrTriangles);
+
+	if (nrTriangles == 0)
+	{
+		return;
+	}
+
+	//screen space depth of a whole scene tends to sit in a tiny range close to 1,
+	//so it gets stretched over the full 16 bits before quantizing
+	float minDepth{ FLT_MAX };
+	float maxDepth{ -FLT_MAX };
+	for (const ScreenTriangle& triangle : m_ScreenTriangles)
+	{
+		minDepth = std::min(minDepth, triangle.minZ);
+		maxDepth = std::max(maxDepth, triangle.minZ);
+	}
+
+	const float depthScale{ (maxDepth > minDepth) ? UINT16_MAX / (maxDepth - minDepth) : 0.0f };
+	for (uint32_t index{}; index < nrTriangles; ++index)
+	{
+		m_SortKeys[index] = static_cast<uint16_t>((m_ScreenTriangles[index].minZ - minDepth) * depthScale);
+		m_TriangleOrder[index] = index;
+	}
+
+	//LSD radix sort, two passes of 8 bits, stable so equal depths keep their submission order
+	for (int shift{}; shift < 16; shift += 8)
+	{
+		uint32_t offsets[256]{};
+		for (const uint32_t triangleIndex : m_TriangleOrder)
+		{
+			++offsets[(m_SortKeys[triangleIndex] >> shift) & 0xFF];
+		}
+
+		uint32_t total{};
+		for (uint32_t& offset : offsets)
+		{
+			const uint32_t count{ offset };
+			offset = total;
+			total += count;
+		}
+
+		for (const uint32_t triangleIndex : m_TriangleOrder)
+		{
+			m_SortScratch[offsets[(m_SortKeys[triangleIndex] >> shift) & 0xFF]++] = triangleIndex;
+		}
+
+		m_TriangleOrder.swap(m_SortScratch);
+	}
+}
+
+uint8_t Renderer::GetClipFlags(const Vector4& position) const
+{
+	uint8_t clipFlags{};
+
+	if (position.x < -position.w) clipFlags |= ClipLeft;
+	if (position.x > position.w) clipFlags |= ClipRight;
+	if (position.y < -position.w) clipFlags |= ClipBottom;
+	if (position.y > position.w) clipFlags |= ClipTop;
+	if (position.z < 0) clipFlags |= ClipNear;
+	if (position.z > position.w) clipFlags |= ClipFar;
+
+	if (abs(position.x) > GUARD_BAND * position.w or abs(position.y) > GUARD_BAND * position.w)
+	{
+		clipFlags |= ClipGuardBand;
+	}
+
+	return clipFlags;
+}
+
+float Renderer::GetClipSpaceDeterminant(const uint32_t vertexIndices[3]) const
+{
+	const Vector4& position0{ m_Mesh->vertices_out.positions[vertexIndices[0]] };
+	const Vector4& position1{ m_Mesh->vertices_out.positions[vertexIndices[1]] };
+	const Vector4& position2{ m_Mesh->vertices_out.positions[vertexIndices[2]] };
+
+	return (position0.x * ((position1.y * position2.w) - (position1.w * position2.y)))
+		- (position0.y * ((position1.x * position2.w) - (position1.w * position2.x)))
+		+ (position0.w * ((position1.x * position2.y) - (position1.y * position2.x)));
+}
+
+float Renderer::GetClipDistance(const Vector4& position, int clipPlane) const
+{
+	//positive means inside
+	switch (clipPlane)
+	{
+	case 0: return position.z;
+	case 1: return position.w - position.z;
+	case 2: return position.x + (GUARD_BAND * position.w);
+	case 3: return (GUARD_BAND * position.w) - position.x;
+	case 4: return position.y + (GUARD_BAND * position.w);
+	default: return (GUARD_BAND * position.w) - position.y;
+	}
+}
+
+void Renderer::ClipTriangle(const uint32_t vertexIndices[3], uint8_t clipFlags)
+{
+	//copies, the originals may still be used by unclipped neighbours
+	Vertex_Out polygon[MAX_CLIPPED_VERTICES]{ m_Mesh->vertices_out.Get(vertexIndices[0]), m_Mesh->vertices_out.Get(vertexIndices[1]), m_Mesh->vertices_out.Get(vertexIndices[2]) };
+	Vertex_Out clippedPolygon[MAX_CLIPPED_VERTICES]{};
+	int nrVertices{ 3 };
+
+	//x and y are only clipped when a vertex is beyond the guard band, within it the bounding box clamp takes care of the screen edges
+	const bool clipPlanes[NR_CLIP_PLANES]
+	{
+		(clipFlags & ClipNear) != 0,
+		(clipFlags & ClipFar) != 0,
+		(clipFlags & ClipGuardBand) != 0,
+		(clipFlags & ClipGuardBand) != 0,
+		(clipFlags & ClipGuardBand) != 0,
+		(clipFlags & ClipGuardBand) != 0
+	};
+
+	//Sutherland-Hodgman, one plane at a time
+	for (int clipPlane{}; clipPlane < NR_CLIP_PLANES; ++clipPlane)
+	{
+		if (clipPlanes[clipPlane] == false)
+		{
+			continue;
+		}
+
+		int nrClippedVertices{};
+		for (int index{}; index < nrVertices; ++index)
+		{
+			const Vertex_Out& current{ polygon[index] };
+			const Vertex_Out& next{ polygon[(index + 1) % nrVertices] };
+
+			const float currentDistance{ GetClipDistance(current.position, clipPlane) };
+			const float nextDistance{ GetClipDistance(next.position, clipPlane) };
+
+			if (currentDistance >= 0)
+			{
+				clippedPolygon[nrClippedVertices++] = current;
+			}
+
+			if ((currentDistance >= 0) != (nextDistance >= 0))
+			{
+				clippedPolygon[nrClippedVertices++] = Vertex_Out::Lerp(current, next, currentDistance / (currentDistance - nextDistance));
+			}
+		}
+
+		nrVertices = nrClippedVertices;
+		if (nrVertices < 3)
+		{
+			return;
+		}
+
+		std::copy_n(clippedPolygon, nrVertices, polygon);
+	}
+
+	//the polygon is stored once after the mesh vertices and fanned into triangles that index it
+	const uint32_t firstVertex{ static_cast<uint32_t>(m_Mesh->vertices_out.GetSize()) };
+	for (int index{}; index < nrVertices; ++index)
+	{
+		m_Mesh->vertices_out.PushBack(polygon[index]);
+	}
+	m_Mesh->isVertex_outInScreenSpace.resize(m_Mesh->vertices_out.GetSize(), false);
+
+	for (int index{ 1 }; index + 1 < nrVertices; ++index)
+	{
+		ScreenTriangle triangle{};
+		triangle.vertexIndices[0] = firstVertex;
+		triangle.vertexIndices[1] = firstVertex + index;
+		triangle.vertexIndices[2] = firstVertex + index + 1;
+
+		m_ScreenTriangles.push_back(triangle);
+	}
+}
+
+void Renderer::RenderTile(uint32_t tileIndex)
+{
+	const int tileMinX{ static_cast<int>(tileIndex % m_NrTilesX) * TILE_SIZE };
+	const int tileMinY{ static_cast<int>(tileIndex / m_NrTilesX) * TILE_SIZE };
+	const int tileMaxX{ std::min(tileMinX + TILE_SIZE, m_Width) };
+	const int tileMaxY{ std::min(tileMinY + TILE_SIZE, m_Height) };
+
+	//triangles were binned in submission order, so the depth test resolves exactly like a serial render
+	for (const uint32_t triangleIndex : m_TileBins[tileIndex])
+	{
+		const ScreenTriangle& triangle{ m_ScreenTriangles[triangleIndex] };
+
+		const int minX{ std::max(triangle.minX, tileMinX) };
+		const int maxX{ std::min(triangle.maxX, tileMaxX) };
+		const int minY{ std::max(triangle.minY, tileMinY) };
+		const int maxY{ std::min(triangle.maxY, tileMaxY) };
+
+		//the interpolated depth never gets closer than the closest vertex,
+		//so if everything already drawn here is closer than that the triangle can't pass a single depth test
+		if (m_ShowBoundingBox == false)
+		{
+			if (m_TileMaxDepth[tileIndex] < triangle.minZ or GetHiZMaxDepth(minX, maxX, minY, maxY) < triangle.minZ)
+			{
+				continue;
+			}
+		}
+
+		const uint64_t writtenHiZBlocks{ (triangle.smallCoverageMask != 0 and m_ShowBoundingBox == false) ?
+			RenderSmallTriangle(triangle, minX, maxX, minY, maxY) :
+			RenderStrip(triangle, minX, maxX, minY, maxY) };
+		if (writtenHiZBlocks != 0)
+		{
+			UpdateHiZ(tileIndex, writtenHiZBlocks);
+		}
+	}
+
+	//every triangle of this tile has been resolved, so only the visible surface is left to shade
+	if (m_UseVisibilityBuffer and m_ShowBoundingBox == false)
+	{
+		ShadeVisibilityBuffer(tileMinX, tileMaxX, tileMinY, tileMaxY);
+	}
+
+	if (m_CollectPixelStats == false)
+	{
+		return;
+	}
+
+	uint32_t nrCoveredPixels{};
+	for (int py{ tileMinY }; py < tileMaxY; ++py)
+	{
+		for (int px{ tileMinX }; px < tileMaxX; ++px)
+		{
+			if (m_pDepthBufferPixels[px + (py * m_Width)] != FLT_MAX)
+			{
+				++nrCoveredPixels;
+			}
+		}
+	}
+	m_TileStats[tileIndex].nrCoveredPixels = nrCoveredPixels;
+}
+
+void Renderer::ShadeVisibilityBuffer(int minX, int maxX, int minY, int maxY)
+{
+	for (int py{ minY }; py < maxY; ++py)
+	{
+		for (int px{ minX }; px < maxX; ++px)
+		{
+			const int pixelIndex{ px + (py * m_Width) };
+			const uint32_t triangleId{ m_pVisibilityBufferPixels[pixelIndex] };
+
+			if (triangleId == NO_TRIANGLE)
+			{
+				continue;
+			}
+
+			const ScreenTriangle& triangle{ m_ScreenTriangles[triangleId] };
+
+			const float dx{ (static_cast<float>(px) + 0.5f) - triangle.planeOrigin.x };
+			const float dy{ (static_cast<float>(py) + 0.5f) - triangle.planeOrigin.y };
+			const float interpolatedW{ 1 / triangle.invWPlane.Evaluate(dx, dy) };
+
+			ShadePixel(triangle, px, py, m_pDepthBufferPixels[pixelIndex], interpolatedW);
+		}
+	}
+}
+
+float Renderer::GetHiZMaxDepth(int minX, int maxX, int minY, int maxY) const
+{
+	float maxDepth{};
+
+	for (int blockY{ minY / HIZ_BLOCK_SIZE }; blockY <= (maxY - 1) / HIZ_BLOCK_SIZE; ++blockY)
+	{
+		for (int blockX{ minX / HIZ_BLOCK_SIZE }; blockX <= (maxX - 1) / HIZ_BLOCK_SIZE; ++blockX)
+		{
+			maxDepth = std::max(maxDepth, m_HiZMaxDepth[blockX + (blockY * m_NrHiZBlocksX)]);
+		}
+	}
+
+	return maxDepth;
+}
+
+void Renderer::UpdateHiZ(uint32_t tileIndex, uint64_t writtenHiZBlocks)
+{
+	const int tileMinX{ static_cast<int>(tileIndex % m_NrTilesX) * TILE_SIZE };
+	const int tileMinY{ static_cast<int>(tileIndex / m_NrTilesX) * TILE_SIZE };
+
+	//only the blocks that received a depth write can have moved closer
+	for (int bit{}; bit < HIZ_BLOCKS_PER_TILE * HIZ_BLOCKS_PER_TILE; ++bit)
+	{
+		if ((writtenHiZBlocks & (uint64_t(1) << bit)) == 0)
+		{
+			continue;
+		}
+
+		const int minX{ tileMinX + (bit % HIZ_BLOCKS_PER_TILE) * HIZ_BLOCK_SIZE };
+		const int minY{ tileMinY + (bit / HIZ_BLOCKS_PER_TILE) * HIZ_BLOCK_SIZE };
+		const int maxX{ std::min(minX + HIZ_BLOCK_SIZE, m_Width) };
+		const int maxY{ std::min(minY + HIZ_BLOCK_SIZE, m_Height) };
+
+		float maxDepth{};
+		for (int py{ minY }; py < maxY; ++py)
+		{
+			for (int px{ minX }; px < maxX; ++px)
+			{
+				maxDepth = std::max(maxDepth, m_pDepthBufferPixels[px + (py * m_Width)]);
+			}
+		}
+
+		m_HiZMaxDepth[(minX / HIZ_BLOCK_SIZE) + ((minY / HIZ_BLOCK_SIZE) * m_NrHiZBlocksX)] = maxDepth;
+	}
+
+	m_TileMaxDepth[tileIndex] = GetHiZMaxDepth(tileMinX, std::min(tileMinX + TILE_SIZE, m_Width), tileMinY, std::min(tileMinY + TILE_SIZE, m_Height));
+}
+
+bool Renderer::SetupTriangle(ScreenTriangle& triangle) const
+{
+	const VertexOutStreams& vertices_out{ m_Mesh->vertices_out };
+	const uint32_t index0{ triangle.vertexIndices[0] };
+	const uint32_t index1{ triangle.vertexIndices[1] };
+	const uint32_t index2{ triangle.vertexIndices[2] };
+
+	//only positions until the triangle is known to cover something
+	const Vector4& position0{ vertices_out.screenPositions[index0] };
+	const Vector4& position1{ vertices_out.screenPositions[index1] };
+	const Vector4& position2{ vertices_out.screenPositions[index2] };
+
+	const Vector2 v0{ position0.GetXY() };
+	const Vector2 v1{ position1.GetXY() };
+	const Vector2 v2{ position2.GetXY() };
+
+	triangle.edges[0] = EdgeFunction(v0, v1);
+	triangle.edges[1] = EdgeFunction(v1, v2);
+	triangle.edges[2] = EdgeFunction(v2, v0);
+
+	//the three edge functions always add up to twice the area of the triangle
+	//BinTriangles already turned every triangle that is kept to face the camera, anything else is rounding on an edge-on triangle
+	const float doubleArea{ Vector2::Cross(v1 - v0, v2 - v0) };
+	if (doubleArea <= 0.0f)
+	{
+		return false;
+	}
+
+	if (m_UseFixedPointRaster)
+	{
+		//positions were snapped in ConvertToScreenSpace, so these conversions are exact
+		const int64_t x0{ static_cast<int64_t>(v0.x * SUBPIXEL_SCALE) };
+		const int64_t y0{ static_cast<int64_t>(v0.y * SUBPIXEL_SCALE) };
+		const int64_t x1{ static_cast<int64_t>(v1.x * SUBPIXEL_SCALE) };
+		const int64_t y1{ static_cast<int64_t>(v1.y * SUBPIXEL_SCALE) };
+		const int64_t x2{ static_cast<int64_t>(v2.x * SUBPIXEL_SCALE) };
+		const int64_t y2{ static_cast<int64_t>(v2.y * SUBPIXEL_SCALE) };
+
+		if (((x1 - x0) * (y2 - y0)) - ((y1 - y0) * (x2 - x0)) <= 0)
+		{
+			return false;
+		}
+
+		triangle.fixedEdges[0] = FixedEdgeFunction(x0, y0, x1, y1);
+		triangle.fixedEdges[1] = FixedEdgeFunction(x1, y1, x2, y2);
+		triangle.fixedEdges[2] = FixedEdgeFunction(x2, y2, x0, y0);
+	}
+
+	//most of a dense mesh ends up here, deciding coverage now means triangles that miss every pixel center
+	//never pay for the attribute planes below and never get binned
+	if (m_UseSmallTrianglePath and triangle.maxX - triangle.minX <= SMALL_TRIANGLE_SIZE and triangle.maxY - triangle.minY <= SMALL_TRIANGLE_SIZE)
+	{
+		triangle.smallCoverageMask = CalculateSmallCoverageMask(triangle);
+		if (triangle.smallCoverageMask == 0)
+		{
+			return false;
+		}
+	}
+
+	triangle.invDoubleArea = 1.0f / doubleArea;
+
+	triangle.minZ = std::min({ position0.z, position1.z, position2.z });
+
+	//every attribute becomes a plane over the screen, anchored at vertex0
+	//the weight of every vertex comes from the edge opposite of it
+	const EdgeFunction& edge0{ triangle.edges[1] };
+	const EdgeFunction& edge1{ triangle.edges[2] };
+	const EdgeFunction& edge2{ triangle.edges[0] };
+
+	const auto makePlane{ [&](float value0, float value1, float value2)
+		{
+			AttributePlane plane{};
+			plane.value = value0;
+			plane.stepX = ((value0 * edge0.stepX) + (value1 * edge1.stepX) + (value2 * edge2.stepX)) * triangle.invDoubleArea;
+			plane.stepY = ((value0 * edge0.stepY) + (value1 * edge1.stepY) + (value2 * edge2.stepY)) * triangle.invDoubleArea;
+			return plane;
+		} };
+
+	triangle.planeOrigin = v0;
+
+	//depth is affine in screen space after the perspective divide
+	triangle.depthPlane = makePlane(position0.z, position1.z, position2.z);
+
+	//everything else is interpolated as attribute / w and divided by the interpolated 1 / w per pixel
+	const float invW0{ 1.0f / position0.w };
+	const float invW1{ 1.0f / position1.w };
+	const float invW2{ 1.0f / position2.w };
+	triangle.invWPlane = makePlane(invW0, invW1, invW2);
+
+	for (int channel{}; channel < 2; ++channel)
+	{
+		triangle.uvPlanes[channel] = makePlane(vertices_out.uvs[index0][channel] * invW0, vertices_out.uvs[index1][channel] * invW1, vertices_out.uvs[index2][channel] * invW2);
+	}
+
+	//the shader has always worked with a third of the blended normal, tangent and view direction, that scale is baked in here
+	const float third{ 1.0f / 3.0f };
+	for (int channel{}; channel < 3; ++channel)
+	{
+		triangle.normalPlanes[channel] = makePlane(vertices_out.normals[index0][channel] * invW0 * third, vertices_out.normals[index1][channel] * invW1 * third, vertices_out.normals[index2][channel] * invW2 * third);
+		triangle.tangentPlanes[channel] = makePlane(vertices_out.tangents[index0][channel] * invW0 * third, vertices_out.tangents[index1][channel] * invW1 * third, vertices_out.tangents[index2][channel] * invW2 * third);
+		triangle.viewDirectionPlanes[channel] = makePlane(vertices_out.viewDirections[index0][channel] * invW0 * third, vertices_out.viewDirections[index1][channel] * invW1 * third, vertices_out.viewDirections[index2][channel] * invW2 * third);
+	}
+
+	return true;
+}
+
+void Renderer::CalculateRowEdgeValues(const ScreenTriangle& triangle, int py, int firstX, int lastX, float rowEdgeValues[3][TILE_SIZE])
+{
+	//restart columns sit every EDGE_RESTART_WIDTH pixels from the triangle's minX, start at the last one at or before firstX
+	const int firstRestartX{ triangle.minX + (((firstX - triangle.minX) / EDGE_RESTART_WIDTH) * EDGE_RESTART_WIDTH) };
+	const float pixelCenterY{ static_cast<float>(py) + 0.5f };
+
+	for (int edgeIndex{}; edgeIndex < 3; ++edgeIndex)
+	{
+		const EdgeFunction& edge{ triangle.edges[edgeIndex] };
+
+		for (int restartX{ firstRestartX }; restartX < lastX; restartX += EDGE_RESTART_WIDTH)
+		{
+			const int segmentEnd{ std::min(restartX + EDGE_RESTART_WIDTH, lastX) };
+			float edgeValue{ edge.Evaluate(static_cast<float>(restartX) + 0.5f, pixelCenterY) };
+
+			for (int px{ restartX }; px < segmentEnd; ++px, edgeValue += edge.stepX)
+			{
+				if (px >= firstX)
+				{
+					rowEdgeValues[edgeIndex][px - firstX] = edgeValue;
+				}
+			}
+		}
+	}
+}
+
+uint64_t Renderer::CalculateSmallCoverageMask(const ScreenTriangle& triangle) const
+{
+	uint64_t coverageMask{};
+
+	for (int row{}; row < triangle.maxY - triangle.minY; ++row)
+	{
+		const int py{ triangle.minY + row };
+		uint64_t rowMask{};
+
+		if (m_UseFixedPointRaster)
+		{
+			int64_t edgeValues[3]{};
+			for (int edgeIndex{}; edgeIndex < 3; ++edgeIndex)
+			{
+				edgeValues[edgeIndex] = triangle.fixedEdges[edgeIndex].Evaluate(triangle.minX, py);
+			}
+
+			for (int lane{}; lane < triangle.maxX - triangle.minX; ++lane)
+			{
+				const int64_t laneEdgeValues[3]
+				{
+					edgeValues[0] + (triangle.fixedEdges[0].stepX * SUBPIXEL_SCALE * lane),
+					edgeValues[1] + (triangle.fixedEdges[1].stepX * SUBPIXEL_SCALE * lane),
+					edgeValues[2] + (triangle.fixedEdges[2].stepX * SUBPIXEL_SCALE * lane)
+				};
+				rowMask |= uint64_t((laneEdgeValues[0] | laneEdgeValues[1] | laneEdgeValues[2]) >= 0) << lane;
+			}
+		}
+		else
+		{
+			//the same stepped values and the same test RenderStrip uses
+			float rowEdgeValues[3][TILE_SIZE]{};
+			CalculateRowEdgeValues(triangle, py, triangle.minX, triangle.maxX, rowEdgeValues);
+			for (int lane{}; lane < triangle.maxX - triangle.minX; ++lane)
+			{
+				const bool isOutside{ rowEdgeValues[0][lane] < 0 or rowEdgeValues[1][lane] < 0 or rowEdgeValues[2][lane] < 0 };
+				rowMask |= uint64_t(isOutside == false) << lane;
+			}
+		}
+
+		coverageMask |= rowMask << (row * SMALL_TRIANGLE_SIZE);
+	}
+
+	return coverageMask;
+}
+
+uint64_t Renderer::RenderSmallTriangle(const ScreenTriangle& triangle, int minX, int maxX, int minY, int maxY)
+{
+	//coverage is already known, only the part of the mask inside this tile is left to depth test and shade
+	const int tileMinX{ (minX / TILE_SIZE) * TILE_SIZE };
+	const int tileMinY{ (minY / TILE_SIZE) * TILE_SIZE };
+	uint64_t writtenHiZBlocks{};
+
+	for (uint64_t coverageMask{ triangle.smallCoverageMask }; coverageMask != 0; coverageMask &= coverageMask - 1)
+	{
+		const int bit{ std::countr_zero(coverageMask) };
+		const int px{ triangle.minX + (bit % SMALL_TRIANGLE_SIZE) };
+		const int py{ triangle.minY + (bit / SMALL_TRIANGLE_SIZE) };
+
+		if (px < minX or px >= maxX or py < minY or py >= maxY)
+		{
+			continue;
+		}
+
+		const int pixelIndex{ px + (py * m_Width) };
+
+		const float dx{ (static_cast<float>(px) + 0.5f) - triangle.planeOrigin.x };
+		const float dy{ (static_cast<float>(py) + 0.5f) - triangle.planeOrigin.y };
+		const float interpolatedZ{ triangle.depthPlane.Evaluate(dx, dy) };
+
+		if (m_pDepthBufferPixels[pixelIndex] < interpolatedZ)
+		{
+			continue;
+		}
+
+		m_pDepthBufferPixels[pixelIndex] = interpolatedZ;
+		writtenHiZBlocks |= uint64_t(1) << (((px - tileMinX) / HIZ_BLOCK_SIZE) + (((py - tileMinY) / HIZ_BLOCK_SIZE) * HIZ_BLOCKS_PER_TILE));
+
+		if (m_UseVisibilityBuffer)
+		{
+			m_pVisibilityBufferPixels[pixelIndex] = triangle.id;
+			continue;
+		}
+
+		const float interpolatedW{ 1 / triangle.invWPlane.Evaluate(dx, dy) };
+		ShadePixel(triangle, px, py, interpolatedZ, interpolatedW);
+	}
+
+	return writtenHiZBlocks;
+}
+
+uint64_t Renderer::RenderStrip(const ScreenTriangle& triangle, int minX, int maxX, int minY, int maxY)
+{
+	if (m_ShowBoundingBox)
+	{
+		const ColorRGB finalColor{ colors::White };
+
+		for (int py{ minY }; py < maxY; ++py)
+		{
+			for (int px{ minX }; px < maxX; ++px)
+			{
+				const int pixelIndex{ px + (py * m_Width) };
+
+				m_pBackBufferPixels[pixelIndex] = SDL_MapRGB(m_pBackBuffer->format,
+					static_cast<uint8_t>(finalColor.r * 255),
+					static_cast<uint8_t>(finalColor.g * 255),
+					static_cast<uint8_t>(finalColor.b * 255));
+			}
+		}
+		return 0;
+	}
+
+	//float edge values of every pixel of the current row, a strip never crosses a tile border so it is at most TILE_SIZE wide
+	float rowEdgeValues[3][TILE_SIZE]{};
+
+	//integer version of the same stepping, one pixel is SUBPIXEL_SCALE sub-pixels
+	int64_t fixedRowEdgeValues[3]{};
+	int64_t fixedBlockEdgeSteps[3]{};
+	if (m_UseFixedPointRaster)
+	{
+		for (int edgeIndex{}; edgeIndex < 3; ++edgeIndex)
+		{
+			fixedRowEdgeValues[edgeIndex] = triangle.fixedEdges[edgeIndex].Evaluate(minX, minY);
+			fixedBlockEdgeSteps[edgeIndex] = triangle.fixedEdges[edgeIndex].stepX * SUBPIXEL_SCALE * RASTER_BLOCK_WIDTH;
+		}
+	}
+
+	//a rectangle never crosses a tile border, so every hi-z block it touches fits in one bit of a 64 bit mask
+	const int tileMinX{ (minX / TILE_SIZE) * TILE_SIZE };
+	const int tileMinY{ (minY / TILE_SIZE) * TILE_SIZE };
+	uint64_t writtenHiZBlocks{};
+
+	for (int py{ minY }; py < maxY; ++py)
+	{
+		if (m_UseFixedPointRaster == false)
+		{
+			CalculateRowEdgeValues(triangle, py, minX, maxX, rowEdgeValues);
+		}
+		int64_t fixedBlockEdgeValues[3]{ fixedRowEdgeValues[0], fixedRowEdgeValues[1], fixedRowEdgeValues[2] };
+
+		const int hiZRow{ py / HIZ_BLOCK_SIZE };
+		const int tileHiZRow{ (py - tileMinY) / HIZ_BLOCK_SIZE };
+
+		for (int blockX{ minX }; blockX < maxX; blockX += RASTER_BLOCK_WIDTH)
+		{
+			const int nrPixels{ std::min(RASTER_BLOCK_WIDTH, maxX - blockX) };
+			const float* const blockEdgeValues[3]{ rowEdgeValues[0] + (blockX - minX), rowEdgeValues[1] + (blockX - minX), rowEdgeValues[2] + (blockX - minX) };
+
+			//an unaligned block can straddle two hi-z blocks
+			const int firstHiZColumn{ blockX / HIZ_BLOCK_SIZE };
+			const int lastHiZColumn{ (blockX + nrPixels - 1) / HIZ_BLOCK_SIZE };
+			const float blockMaxDepth{ std::max(m_HiZMaxDepth[firstHiZColumn + (hiZRow * m_NrHiZBlocksX)], m_HiZMaxDepth[lastHiZColumn + (hiZRow * m_NrHiZBlocksX)]) };
+
+			bool hasWrittenDepth{ false };
+			if (blockMaxDepth < triangle.minZ)
+			{
+				//already fully covered by closer geometry
+			}
+			else if (m_UseFixedPointRaster)
+			{
+				hasWrittenDepth = RasterizeBlockFixedPoint(triangle, blockX, py, nrPixels, fixedBlockEdgeValues);
+			}
+			//partial blocks at the end of a row always go through the scalar path so the simd kernels never read past the buffer
+			else if (nrPixels < RASTER_BLOCK_WIDTH or m_RasterKernel == RasterKernel::Scalar)
+			{
+				hasWrittenDepth = RasterizeBlock(triangle, blockX, py, nrPixels, blockEdgeValues);
+			}
+			else if (m_RasterKernel == RasterKernel::AVX2)
+			{
+				hasWrittenDepth = RasterizeBlockAVX2(triangle, blockX, py, blockEdgeValues);
+			}
+			else
+			{
+				hasWrittenDepth = RasterizeBlockSSE(triangle, blockX, py, blockEdgeValues);
+			}
+
+			if (hasWrittenDepth)
+			{
+				const int tileHiZColumn{ (blockX - tileMinX) / HIZ_BLOCK_SIZE };
+				writtenHiZBlocks |= uint64_t(1) << (tileHiZColumn + (tileHiZRow * HIZ_BLOCKS_PER_TILE));
+				writtenHiZBlocks |= uint64_t(1) << ((tileHiZColumn + lastHiZColumn - firstHiZColumn) + (tileHiZRow * HIZ_BLOCKS_PER_TILE));
+			}
+
+			fixedBlockEdgeValues[0] += fixedBlockEdgeSteps[0];
+			fixedBlockEdgeValues[1] += fixedBlockEdgeSteps[1];
+			fixedBlockEdgeValues[2] += fixedBlockEdgeSteps[2];
+		}
+
+		fixedRowEdgeValues[0] += triangle.fixedEdges[0].stepY * SUBPIXEL_SCALE;
+		fixedRowEdgeValues[1] += triangle.fixedEdges[1].stepY * SUBPIXEL_SCALE;
+		fixedRowEdgeValues[2] += triangle.fixedEdges[2].stepY * SUBPIXEL_SCALE;
+	}
+
+	return writtenHiZBlocks;
+}
+
+bool Renderer::RasterizeBlock(const ScreenTriangle& triangle, int blockX, int py, int nrPixels, const float* const blockEdgeValues[3])
+{
+	const float dy{ (static_cast<float>(py) + 0.5f) - triangle.planeOrigin.y };
+
+	bool hasWrittenDepth{ false };
+
+	for (int lane{}; lane < nrPixels; ++lane)
+	{
+		if (blockEdgeValues[0][lane] < 0 or blockEdgeValues[1][lane] < 0 or blockEdgeValues[2][lane] < 0) continue;
+
+		const int px{ blockX + lane };
+		const int pixelIndex{ px + (py * m_Width) };
+
+		const float dx{ (static_cast<float>(px) + 0.5f) - triangle.planeOrigin.x };
+		const float interpolatedZ{ triangle.depthPlane.Evaluate(dx, dy) };
+
+		if (m_pDepthBufferPixels[pixelIndex] < interpolatedZ)
+		{
+			continue;
+		}
+
+		m_pDepthBufferPixels[pixelIndex] = interpolatedZ;
+		hasWrittenDepth = true;
+
+		if (m_UseVisibilityBuffer)
+		{
+			m_pVisibilityBufferPixels[pixelIndex] = triangle.id;
+			continue;
+		}
+
+		const float interpolatedW{ 1 / triangle.invWPlane.Evaluate(dx, dy) };
+		ShadePixel(triangle, px, py, interpolatedZ, interpolatedW);
+	}
+
+	return hasWrittenDepth;
+}
+
+bool Renderer::RasterizeBlockFixedPoint(const ScreenTriangle& triangle, int blockX, int py, int nrPixels, const int64_t blockEdgeValues[3])
+{
+	const float dy{ (static_cast<float>(py) + 0.5f) - triangle.planeOrigin.y };
+
+	//the top-left bias is already part of the edge values, so >= 0 is the whole fill rule
+	int64_t edgeValues[3]{ blockEdgeValues[0], blockEdgeValues[1], blockEdgeValues[2] };
+	const int64_t edgeSteps[3]{ triangle.fixedEdges[0].stepX * SUBPIXEL_SCALE, triangle.fixedEdges[1].stepX * SUBPIXEL_SCALE, triangle.fixedEdges[2].stepX * SUBPIXEL_SCALE };
+
+	bool hasWrittenDepth{ false };
+
+	for (int lane{}; lane < nrPixels; ++lane, edgeValues[0] += edgeSteps[0], edgeValues[1] += edgeSteps[1], edgeValues[2] += edgeSteps[2])
+	{
+		if ((edgeValues[0] | edgeValues[1] | edgeValues[2]) < 0) continue;
+
+		const int px{ blockX + lane };
+		const int pixelIndex{ px + (py * m_Width) };
+
+		const float dx{ (static_cast<float>(px) + 0.5f) - triangle.planeOrigin.x };
+		const float interpolatedZ{ triangle.depthPlane.Evaluate(dx, dy) };
+
+		if (m_pDepthBufferPixels[pixelIndex] < interpolatedZ)
+		{
+			continue;
+		}
+
+		m_pDepthBufferPixels[pixelIndex] = interpolatedZ;
+		hasWrittenDepth = true;
+
+		if (m_UseVisibilityBuffer)
+		{
+			m_pVisibilityBufferPixels[pixelIndex] = triangle.id;
+			continue;
+		}
+
+		const float interpolatedW{ 1 / triangle.invWPlane.Evaluate(dx, dy) };
+		ShadePixel(triangle, px, py, interpolatedZ, interpolatedW);
+	}
+
+	return hasWrittenDepth;
+}
+
+bool Renderer::RasterizeBlockSSE(const ScreenTriangle& triangle, int blockX, int py, const float* const blockEdgeValues[3])
+{
+	//mirrors RasterizeBlock operation for operation (same operands, same order, no fused multiply-add)
+	//every comparison uses the negated form of the scalar early-out so NaNs end up on the same side
+	const __m128 zero{ _mm_setzero_ps() };
+	const __m128 half{ _mm_set1_ps(0.5f) };
+	const __m128 laneIndices{ _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f) };
+	const __m128 planeOriginX{ _mm_set1_ps(triangle.planeOrigin.x) };
+	const __m128 dy{ _mm_set1_ps((static_cast<float>(py) + 0.5f) - triangle.planeOrigin.y) };
+
+	const __m128 depthValue{ _mm_set1_ps(triangle.depthPlane.value) };
+	const __m128 depthStepX{ _mm_set1_ps(triangle.depthPlane.stepX) };
+	const __m128 depthStepY{ _mm_set1_ps(triangle.depthPlane.stepY) };
+
+	bool hasWrittenDepth{ false };
+
+	alignas(16) float laneZ[4]{};
+
+	for (int firstLane{}; firstLane < RASTER_BLOCK_WIDTH; firstLane += 4)
+	{
+		const int pixelIndex{ blockX + firstLane + (py * m_Width) };
+
+		const __m128 pixelX{ _mm_add_ps(_mm_set1_ps(static_cast<float>(blockX + firstLane)), laneIndices) };
+		const __m128 pixelCenterX{ _mm_add_ps(pixelX, half) };
+
+		__m128 mask{ _mm_castsi128_ps(_mm_set1_epi32(-1)) };
+		for (int edgeIndex{}; edgeIndex < 3; ++edgeIndex)
+		{
+			mask = _mm_and_ps(mask, _mm_cmpnlt_ps(_mm_loadu_ps(blockEdgeValues[edgeIndex] + firstLane), zero));
+		}
+
+		if (_mm_movemask_ps(mask) == 0)
+		{
+			continue;
+		}
+
+		const __m128 dx{ _mm_sub_ps(pixelCenterX, planeOriginX) };
+		const __m128 interpolatedZ{ _mm_add_ps(_mm_add_ps(depthValue, _mm_mul_ps(depthStepX, dx)), _mm_mul_ps(depthStepY, dy)) };
+
+		const __m128 depth{ _mm_loadu_ps(m_pDepthBufferPixels + pixelIndex) };
+		mask = _mm_and_ps(mask, _mm_cmpnlt_ps(depth, interpolatedZ));
+
+		const int laneMask{ _mm_movemask_ps(mask) };
+		if (laneMask == 0)
+		{
+			continue;
+		}
+
+		//masked depth write, lanes that failed keep what was already in the buffer
+		_mm_storeu_ps(m_pDepthBufferPixels + pixelIndex, _mm_or_ps(_mm_and_ps(mask, interpolatedZ), _mm_andnot_ps(mask, depth)));
+		hasWrittenDepth = true;
+
+		_mm_store_ps(laneZ, interpolatedZ);
+
+		for (int lane{}; lane < 4; ++lane)
+		{
+			if ((laneMask & (1 << lane)) == 0)
+			{
+				continue;
+			}
+
+			const int px{ blockX + firstLane + lane };
+
+			if (m_UseVisibilityBuffer)
+			{
+				m_pVisibilityBufferPixels[pixelIndex + lane] = triangle.id;
+				continue;
+			}
+
+			//1 / w is only needed for the pixels that actually get shaded
+			const float laneDx{ (static_cast<float>(px) + 0.5f) - triangle.planeOrigin.x };
+			const float interpolatedW{ 1 / triangle.invWPlane.Evaluate(laneDx, (static_cast<float>(py) + 0.5f) - triangle.planeOrigin.y) };
+
+			ShadePixel(triangle, px, py, laneZ[lane], interpolatedW);
+		}
+	}
+
+	return hasWrittenDepth;
+}
+
+void Renderer::ShadePixel(const ScreenTriangle& triangle, int px, int py, float interpolatedZ, float interpolatedW)
+{
+	if (m_CollectPixelStats)
+	{
+		++m_TileStats[(px / TILE_SIZE) + ((py / TILE_SIZE) * m_NrTilesX)].nrShadedPixels;
+	}
+
+	const float dx{ (static_cast<float>(px) + 0.5f) - triangle.planeOrigin.x };
+	const float dy{ (static_cast<float>(py) + 0.5f) - triangle.planeOrigin.y };
+
+	float remap{ DepthRemap(interpolatedZ, 0.9975f, 1.0f) };
+	ColorRGB finalColor{ remap, remap, remap };
+
+	//one multiply-add per channel, times w to undo the divide from setup
+	Vertex_Out vertexToShade{};
+	vertexToShade.position.x = static_cast<float>(px);
+	vertexToShade.position.y = static_cast<float>(py);
+	vertexToShade.position.z = interpolatedZ;
+	vertexToShade.position.w = interpolatedW;
+	vertexToShade.color = finalColor;
+	vertexToShade.uv = Vector2{ triangle.uvPlanes[0].Evaluate(dx, dy), triangle.uvPlanes[1].Evaluate(dx, dy) } * interpolatedW;
+	vertexToShade.normal = Vector3{ triangle.normalPlanes[0].Evaluate(dx, dy), triangle.normalPlanes[1].Evaluate(dx, dy), triangle.normalPlanes[2].Evaluate(dx, dy) } * interpolatedW;
+	vertexToShade.tangent = Vector3{ triangle.tangentPlanes[0].Evaluate(dx, dy), triangle.tangentPlanes[1].Evaluate(dx, dy), triangle.tangentPlanes[2].Evaluate(dx, dy) } * interpolatedW;
+	vertexToShade.viewDirection = Vector3{ triangle.viewDirectionPlanes[0].Evaluate(dx, dy), triangle.viewDirectionPlanes[1].Evaluate(dx, dy), triangle.viewDirectionPlanes[2].Evaluate(dx, dy) } * interpolatedW;
+	vertexToShade.viewDirection.Normalize();
+
+	finalColor = PixelShading(vertexToShade);
+
+	//Update Color in Buffer
+	finalColor.MaxToOne();
+	//finalColor.ToneMap();
+
+	m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
+		static_cast<uint8_t>(finalColor.r * 255),
+		static_cast<uint8_t>(finalColor.g * 255),
+		static_cast<uint8_t>(finalColor.b * 255));
+}
+
+bool Renderer::CheckCulling(const uint32_t vertexIndices[3])
+{
+	//check for frustum, only a triangle with all vertices outside the same plane can be thrown away
+	//anything else is clipped or handled by the guard band
+	const uint8_t sharedClipFlags{ static_cast<uint8_t>(m_VertexClipFlags[vertexIndices[0]] &
+		m_VertexClipFlags[vertexIndices[1]] &
+		m_VertexClipFlags[vertexIndices[2]]) };
+
+	if (sharedClipFlags & (ClipLeft | ClipRight | ClipBottom | ClipTop | ClipNear | ClipFar))
+	{
+		return true;
+	}
+
+	//check if 2 vertices in triangle are the same => not a triangle => skip
+	if (vertexIndices[0] == vertexIndices[1] or 
+		vertexIndices[0] == vertexIndices[2] or 
+		vertexIndices[1] == vertexIndices[2])
+	{
+		return true;
+	}
+	
+	return false;
+}
+
+void Renderer::CalculateBoundingBox(int& minX, int& maxX, int& minY, int& maxY, const uint32_t vertexIndices[3])
+{
+	const Vector4& position0{ m_Mesh->vertices_out.screenPositions[vertexIndices[0]] };
+	const Vector4& position1{ m_Mesh->vertices_out.screenPositions[vertexIndices[1]] };
+	const Vector4& position2{ m_Mesh->vertices_out.screenPositions[vertexIndices[2]] };
+
+	const float minPositionX{ std::min({ position0.x, position1.x, position2.x }) };
+	const float minPositionY{ std::min({ position0.y, position1.y, position2.y }) };
+	const float maxPositionX{ std::max({ position0.x, position1.x, position2.x }) };
+	const float maxPositionY{ std::max({ position0.y, position1.y, position2.y }) };
+
+	//only pixels whose center (+0.5) lies inside the box can be covered, max is exclusive
+	//the guard band keeps these well inside int range
+	minX = std::max(static_cast<int>(std::ceil(minPositionX - 0.5f)), 0);
+	minY = std::max(static_cast<int>(std::ceil(minPositionY - 0.5f)), 0);
+	maxX = std::min(static_cast<int>(std::floor(maxPositionX - 0.5f)) + 1, m_Width);
+	maxY = std::min(static_cast<int>(std::floor(maxPositionY - 0.5f)) + 1, m_Height);
+}
+
+void Renderer::ConvertToScreenSpace(const uint32_t vertexIndices[3])
+{
+	for (int i = 0; i < 3; i++)
+	{
+		if (m_Mesh->isVertex_outInScreenSpace[vertexIndices[i]] == false)
+		{
+			Vector4& position{ m_Mesh->vertices_out.screenPositions[vertexIndices[i]] };
+			position = m_Mesh->vertices_out.positions[vertexIndices[i]];
+
+			//perspective divide, w is kept for perspective correct interpolation
+			position.x /= position.w;
+			position.y /= position.w;
+			position.z /= position.w;
+
+			position.x = ((position.x + 1) / 2) * float(m_Width);
+			position.y = ((1 - position.y) / 2) * float(m_Height);
+
+			//snapped once per vertex, so every triangle sharing it sees the exact same edge
+			if (m_UseFixedPointRaster)
+			{
+				position.x = std::round(position.x * SUBPIXEL_SCALE) / SUBPIXEL_SCALE;
+				position.y = std::round(position.y * SUBPIXEL_SCALE) / SUBPIXEL_SCALE;
+			}
+			m_Mesh->isVertex_outInScreenSpace[vertexIndices[i]] = true;
+		}
+	}
+}
+
+float Renderer::DepthRemap(const float value, const float fromMin, const float fromMax)
+{
+	float normalizedValue{ (value - fromMin) / (fromMax - fromMin) };
 	if (normalizedValue < 0.0f)
 	{
 		normalizedValue = 0.0f;
@@ -409,11 +1780,13 @@ float Renderer::DepthRemap(const float value, const float fromMin, const float f
 
 void Renderer::ToggleDepthBufferVisuals()
 {
+	m_IsFrameDirty = true;
 	m_ShowDepthBuffer = !m_ShowDepthBuffer;
 	std::cout << "Show depth buffer: " << std::boolalpha << m_ShowDepthBuffer << "\n";
 }
 void Renderer::ToggleUseNormalMap()
 {
+	m_IsFrameDirty = true;
 	m_UseNormalMap = !m_UseNormalMap;
 	std::cout << "Using Normal Map: " << std::boolalpha << m_UseNormalMap << "\n";
 }
@@ -424,6 +1797,7 @@ void Renderer::ToggleRotation()
 }
 void Renderer::ToggleShadingMode()
 {
+	m_IsFrameDirty = true;
 	switch (m_ShadingMode)
 	{
 	case Renderer::ShadingMode::ObservedArea:
@@ -446,9 +1820,183 @@ void Renderer::ToggleShadingMode()
 }
 void Renderer::ToggleShowBoudingBox()
 {
+	m_IsFrameDirty = true;
 	m_ShowBoundingBox = !m_ShowBoundingBox;
 	std::cout << "Show Bounding Box: " << std::boolalpha << m_ShowBoundingBox << "\n";
 }
+void Renderer::ToggleVisibilityBuffer()
+{
+	m_IsFrameDirty = true;
+	m_UseVisibilityBuffer = !m_UseVisibilityBuffer;
+	std::cout << "Use visibility buffer: " << std::boolalpha << m_UseVisibilityBuffer << "\n";
+}
+void Renderer::ToggleFrontToBackSort()
+{
+	m_IsFrameDirty = true;
+	m_SortFrontToBack = !m_SortFrontToBack;
+	std::cout << "Sort front to back: " << std::boolalpha << m_SortFrontToBack << "\n";
+}
+void Renderer::PrintShadingStats()
+{
+	if (m_NrStatsFrames == 0)
+	{
+		return;
+	}
+
+	if (m_CollectPixelStats)
+	{
+		const float shadedPixelsPerFrame{ static_cast<float>(m_NrShadedPixels) / m_NrStatsFrames };
+		const float coveredPixelsPerFrame{ static_cast<float>(m_NrCoveredPixels) / m_NrStatsFrames };
+
+		std::cout << "Shaded pixels: " << shadedPixelsPerFrame << " per frame, "
+			<< "overdraw: " << (coveredPixelsPerFrame > 0.0f ? shadedPixelsPerFrame / coveredPixelsPerFrame : 0.0f) << "x\n";
+
+		if (m_SortFrontToBack == false)
+		{
+			m_UnsortedShadedPixelsPerFrame = shadedPixelsPerFrame;
+		}
+		else if (m_UnsortedShadedPixelsPerFrame > 0.0f)
+		{
+			std::cout << "Front to back sort avoided " << (m_UnsortedShadedPixelsPerFrame - shadedPixelsPerFrame) << " shaded pixels per frame ("
+				<< 100.0f * (1.0f - (shadedPixelsPerFrame / m_UnsortedShadedPixelsPerFrame)) << "%)\n";
+		}
+	}
+
+	if (m_NrCulledMeshFrames > 0)
+	{
+		std::cout << "Mesh was off screen in " << m_NrCulledMeshFrames << " of " << m_NrStatsFrames << " frames\n";
+	}
+
+	if (m_Mesh->meshlets.empty() == false)
+	{
+		std::cout << "Meshlets: " << static_cast<float>(m_NrVisibleMeshlets) / m_NrStatsFrames << " visible, "
+			<< static_cast<float>(m_NrOffScreenMeshlets) / m_NrStatsFrames << " off screen, "
+			<< static_cast<float>(m_NrFaceCulledMeshlets) / m_NrStatsFrames << " face culled per frame\n";
+	}
+
+	m_NrShadedPixels = 0;
+	m_NrCoveredPixels = 0;
+	m_NrCulledMeshFrames = 0;
+	m_NrVisibleMeshlets = 0;
+	m_NrOffScreenMeshlets = 0;
+	m_NrFaceCulledMeshlets = 0;
+	m_NrStatsFrames = 0;
+}
+bool Renderer::IsIdle() const
+{
+	return m_IsIdle;
+}
+bool Renderer::IsAVX2Supported()
+{
+#ifdef _MSC_VER
+	int registers[4]{};
+	__cpuid(registers, 0);
+	if (registers[0] < 7)
+	{
+		return false;
+	}
+
+	//the cpu has to support AVX and the os has to save the ymm registers on a context switch (xcr0 bits 1 and 2)
+	__cpuid(registers, 1);
+	const bool hasOSXSave{ (registers[2] & (1 << 27)) != 0 };
+	const bool hasAVX{ (registers[2] & (1 << 28)) != 0 };
+	if (hasOSXSave == false or hasAVX == false or (_xgetbv(0) & 0x6) != 0x6)
+	{
+		return false;
+	}
+
+	//leaf 7, ebx bit 5
+	__cpuidex(registers, 7, 0);
+	return (registers[1] & (1 << 5)) != 0;
+#else
+	//does the same cpuid and xgetbv checks
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+void Renderer::ToggleFixedPointRaster()
+{
+	m_IsFrameDirty = true;
+	m_UseFixedPointRaster = !m_UseFixedPointRaster;
+	std::cout << "Fixed point raster: " << std::boolalpha << m_UseFixedPointRaster << "\n";
+}
+void Renderer::ToggleMeshletCulling()
+{
+	//changes which meshlets get transformed
+	m_AreVerticesDirty = true;
+	m_IsFrameDirty = true;
+	m_UseMeshletCulling = !m_UseMeshletCulling;
+	std::cout << "Meshlet culling: " << std::boolalpha << m_UseMeshletCulling << "\n";
+}
+void Renderer::ToggleCullMode()
+{
+	//changes which meshlets get transformed
+	m_AreVerticesDirty = true;
+	m_IsFrameDirty = true;
+	switch (m_CullMode)
+	{
+	case Renderer::CullMode::None:
+		std::cout << "Cull mode: Back\n";
+		m_CullMode = CullMode::Back;
+		break;
+	case Renderer::CullMode::Back:
+		std::cout << "Cull mode: Front\n";
+		m_CullMode = CullMode::Front;
+		break;
+	case Renderer::CullMode::Front:
+		std::cout << "Cull mode: None\n";
+		m_CullMode = CullMode::None;
+		break;
+	}
+}
+void Renderer::ToggleQuantizedVertices()
+{
+	//the mesh is loaded again in the other layout, see UpdatePendingAssets, and swapping it in transforms everything again
+	m_UseQuantizedVertices = !m_UseQuantizedVertices;
+	std::cout << "Quantized vertices: " << std::boolalpha << m_UseQuantizedVertices << " ("
+		<< (m_UseQuantizedVertices ? VertexStreams::QUANTIZED_VERTEX_SIZE : VertexStreams::FLOAT_VERTEX_SIZE) << " bytes per vertex)\n";
+}
+void Renderer::TogglePixelStats()
+{
+	m_CollectPixelStats = !m_CollectPixelStats;
+	std::cout << "Pixel stats: " << std::boolalpha << m_CollectPixelStats << "\n";
+
+	//every average starts over, so none of them mixes frames with and without pixel counts
+	m_NrShadedPixels = 0;
+	m_NrCoveredPixels = 0;
+	m_NrCulledMeshFrames = 0;
+	m_NrVisibleMeshlets = 0;
+	m_NrOffScreenMeshlets = 0;
+	m_NrFaceCulledMeshlets = 0;
+	m_NrStatsFrames = 0;
+	m_UnsortedShadedPixelsPerFrame = 0.0f;
+}
+void Renderer::ToggleRasterKernel()
+{
+	m_IsFrameDirty = true;
+	switch (m_RasterKernel)
+	{
+	case Renderer::RasterKernel::Scalar:
+		std::cout << "Raster kernel: SSE\n";
+		m_RasterKernel = RasterKernel::SSE;
+		break;
+	case Renderer::RasterKernel::SSE:
+		if (m_IsAVX2Supported)
+		{
+			std::cout << "Raster kernel: AVX2\n";
+			m_RasterKernel = RasterKernel::AVX2;
+		}
+		else
+		{
+			std::cout << "Raster kernel: Scalar (no AVX2 on this cpu)\n";
+			m_RasterKernel = RasterKernel::Scalar;
+		}
+		break;
+	case Renderer::RasterKernel::AVX2:
+		std::cout << "Raster kernel: Scalar\n";
+		m_RasterKernel = RasterKernel::Scalar;
+		break;
+	}
+}
 
 
 ColorRGB Renderer::PixelShading(const Vertex_Out& v)
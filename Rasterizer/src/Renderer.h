@@ -1,6 +1,9 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <future>
+#include <string>
 #include <vector>
 
 #include "Camera.h"
@@ -16,12 +19,19 @@ namespace dae
 	struct Mesh;
 	struct Vertex;
 	struct Vertex_Out;
+	struct VertexStreams;
+	struct VertexOutStreams;
 	class Timer;
+	class ThreadPool;
+	class AssetLoader;
 	class Scene;
 	enum class PrimitiveTopology;
 
 	class Renderer final
 	{
+		//Unit_Tests drives the kernels directly to check them against each other
+		friend class RendererInternals;
+
 	public:
 		Renderer(SDL_Window* pWindow);
 		~Renderer();
@@ -36,20 +46,23 @@ namespace dae
 
 		bool SaveBufferToImage() const;
 
-		void VertexTransformationFunction(const std::vector<Vertex>& vertices_in, std::vector<Vertex_Out>& vertices_out) const;
+		void VertexTransformationFunction(const VertexStreams& vertices_in, VertexOutStreams& vertices_out);
 
 		void Render_W7();
 
 		void InitializeTriangles(std::vector<Vertex>& verticesNDC, std::vector<uint32_t>& trianglesVertexIndices);
 
-		void RenderStrip(int vertexIndex, float interpolatedZ, float interpolatedW, float totalWeight, Vector2& pixel, Vector2& interpolatedUV, ColorRGB& finalColor, int swapOddVertices1, int swapOddVertices2, int pixelIndex, std::vector<float>& vertices_weights, bool isStrip);
-		void RenderList(int vertexIndex, float interpolatedZ, float interpolatedW, float totalWeight, Vector2& pixel, Vector2& interpolatedUV, ColorRGB& finalColor, int swapOddVertices1, int swapOddVertices2, int pixelIndex, std::vector<float>& vertices_weights);
+		void BinTriangles();
+		void RenderTile(uint32_t tileIndex);
+
 		
-		bool CheckCulling(const int vertexIndex);
+		//vertexIndices always point into vertices_out, in the winding the triangle is rasterized with
+		bool CheckCulling(const uint32_t vertexIndices[3]);
+		void ClipTriangle(const uint32_t vertexIndices[3], uint8_t clipFlags);
 
-		void CalculateBoundingBox(int& minX, int& maxX, int& minY, int& maxY, const int vertexIndex);
+		void CalculateBoundingBox(int& minX, int& maxX, int& minY, int& maxY, const uint32_t vertexIndices[3]);
 
-		void ConvertToScreenSpace(const int vertexIndex);
+		void ConvertToScreenSpace(const uint32_t vertexIndices[3]);
 
 		float DepthRemap(const float value, const float fromMin, const float fromMax);
 
@@ -58,6 +71,19 @@ namespace dae
 		void ToggleRotation();
 		void ToggleShadingMode();
 		void ToggleShowBoudingBox();
+		void ToggleRasterKernel();
+		void ToggleVisibilityBuffer();
+		void ToggleFrontToBackSort();
+		void ToggleFixedPointRaster();
+		void ToggleMeshletCulling();
+		void ToggleCullMode();
+		void ToggleQuantizedVertices();
+		void TogglePixelStats();
+
+		void PrintShadingStats();
+
+		//true when the last Render had nothing new to draw and just showed the previous frame again
+		bool IsIdle() const;
 
 		ColorRGB PixelShading(const Vertex_Out& v);
 
@@ -73,6 +99,11 @@ namespace dae
 
 		float* m_pDepthBufferPixels{};
 
+		//Visibility buffer: index into m_ScreenTriangles of the closest triangle per pixel, NO_TRIANGLE where nothing was drawn
+		//together with the depth buffer and the triangle's attribute planes this is enough to shade the pixel afterwards
+		static constexpr uint32_t NO_TRIANGLE{ UINT32_MAX };
+		uint32_t* m_pVisibilityBufferPixels{};
+
 		Camera m_Camera{};
 
 		int m_Width{};
@@ -84,12 +115,351 @@ namespace dae
 		Texture* m_SpecularTexture;
 
 		Mesh* m_Mesh = nullptr;
+
+		//Assets are loaded in the background, until a load is done the renderer uses a placeholder (solid color textures, an empty mesh)
+		//UpdatePendingAssets swaps in whatever finished since the last frame
+		struct PendingTexture
+		{
+			std::future<Texture*> future;
+			Texture** ppTexture;
+		};
+		//a handful of loads that mostly wait on the disk, more loader threads would only take cores from rendering
+		static constexpr uint32_t NR_ASSET_LOADER_THREADS{ 2 };
+		//threads of the pool the mesh load splits the OBJ parse over, m_pThreadPool is busy rendering in the meantime
+		static constexpr uint32_t NR_MESH_LOAD_THREADS{ 4 };
+		AssetLoader* m_pAssetLoader{ nullptr };
+		std::vector<PendingTexture> m_PendingTextures{};
+		std::future<Mesh*> m_PendingMesh{};
+		std::chrono::steady_clock::time_point m_LoadStart{};
+		void UpdatePendingAssets();
+		//Loads the mesh on a loader thread with the current settings, UpdatePendingAssets swaps it in when it's done
+		void EnqueueMeshLoad();
 		float m_ModelYRotation{};
 
+		//Vertices transformed per simd iteration in the vertex stage
+		static constexpr int SSE_VERTEX_BATCH_SIZE{ 4 };
+		static constexpr int AVX2_VERTEX_BATCH_SIZE{ 8 };
+
+		//The vertex stage is split in chunks of VERTEX_CHUNK_SIZE vertices that run on the thread pool
+		static constexpr int VERTEX_CHUNK_SIZE{ 2048 };
+		static_assert(VERTEX_CHUNK_SIZE % AVX2_VERTEX_BATCH_SIZE == 0, "a vertex chunk has to hold whole batches");
+
+		//Outcodes of every transformed mesh vertex, written by the chunk that transformed it
+		std::vector<uint8_t> m_VertexClipFlags{};
+
+		//One component of every vertex in a batch, sized for the widest one
+		struct VertexBatch
+		{
+			alignas(32) float positions[4][AVX2_VERTEX_BATCH_SIZE]{};
+			alignas(32) float normals[3][AVX2_VERTEX_BATCH_SIZE]{};
+			alignas(32) float tangents[3][AVX2_VERTEX_BATCH_SIZE]{};
+			//only filled for quantized streams, float uvs are copied straight from the input
+			alignas(32) float uvs[2][AVX2_VERTEX_BATCH_SIZE]{};
+		};
+
+		//The input streams as raw pointers and plain floats, RendererAVX2.cpp can't index the vectors or read the Vector members of VertexStreams itself
+		struct VertexStreamPointers
+		{
+			bool isQuantized{};
+			const float* pPositions[3]{};
+			const float* pNormals[3]{};
+			const float* pTangents[3]{};
+
+			const uint16_t* pQuantizedPositions[3]{};
+			const uint16_t* pQuantizedUVs[2]{};
+			const int16_t* pOctahedralNormals[2]{};
+			const int16_t* pOctahedralTangents[2]{};
+			float positionOffset[3]{};
+			float positionScale[3]{};
+			float uvOffset[2]{};
+			float uvScale[2]{};
+		};
+
+		//Transforms with SSE, or hands the chunk to TransformVertexChunkAVX2 when the cpu has AVX2
+		void TransformVertexChunk(const Matrix& finalMatrix, int firstChunkVertex, int lastChunkVertex, const VertexStreams& vertices_in, VertexOutStreams& vertices_out);
+		//The matrices come in as plain floats, [row][column], Matrix can't be touched from RendererAVX2.cpp
+		//vertices_in is only handed on to StoreVertexBatch, the streams are read through streams_in
+		void TransformVertexChunkAVX2(const float finalElements[4][4], const float worldElements[3][3], int firstChunkVertex, int lastChunkVertex, const VertexStreamPointers& streams_in, const VertexStreams& vertices_in, VertexOutStreams& vertices_out);
+		//Puts the first nrLanes vertices of the batch back together in the output streams and sets their clip flags
+		void StoreVertexBatch(const VertexBatch& batch, int firstVertex, int nrLanes, const VertexStreams& vertices_in, VertexOutStreams& vertices_out);
+
+		//Planes of the view frustum in the space the matrix transforms from, normalized and pointing inwards
+		static constexpr int NR_FRUSTUM_PLANES{ 6 };
+		void CalculateFrustumPlanes(const Matrix& matrix, Vector4 planes[NR_FRUSTUM_PLANES]) const;
+
+		//Tests the mesh's cached world bounds, a mesh that fails skips the vertex stage and binning entirely
+		bool IsMeshInFrustum() const;
+		uint32_t m_NrCulledMeshFrames{};
+
+		//Meshlets that survived CullMeshlets this frame, only their vertices get transformed and only their triangles binned
+		//meshes without meshlets skip all of this and go through the vertex stage in VERTEX_CHUNK_SIZE chunks
+		std::vector<uint32_t> m_VisibleMeshlets{};
+		void CullMeshlets();
+
+		//The vertex stage of a mesh with meshlets skips every block of VERTEX_BLOCK_SIZE vertices no visible meshlet uses
+		//BuildMeshlets numbers the vertices in meshlet order, so a meshlet's vertices are mostly in the same few blocks
+		static constexpr int VERTEX_BLOCK_SIZE{ 64 };
+		static constexpr uint32_t VERTEX_BLOCKS_PER_JOB{ 32 };
+		static_assert(VERTEX_BLOCK_SIZE % AVX2_VERTEX_BATCH_SIZE == 0, "a vertex block has to hold whole batches");
+		std::vector<uint8_t> m_IsVertexBlockUsed{};
+
+		uint64_t m_NrVisibleMeshlets{};
+		uint64_t m_NrOffScreenMeshlets{};
+		uint64_t m_NrFaceCulledMeshlets{};
+
 		bool m_ShowDepthBuffer = false;
 		bool m_UseNormalMap = false;
 		bool m_IsRotating = true;
 		bool m_ShowBoundingBox = false;
+		bool m_UseVisibilityBuffer = false;
+		bool m_SortFrontToBack = false;
+		bool m_UseFixedPointRaster = false;
+		bool m_UseMeshletCulling = true;
+		//the vertex stage reads the compact vertex streams (unorm16 positions and uvs, octahedral normals and tangents) and decodes them as it goes
+		//the loaded vertices are released once the streams are built, so switching layouts loads the mesh again
+		bool m_UseQuantizedVertices = false;
+
+		//Dirty tracking: a frame is only rendered when something changed since the last one,
+		//and the vertex stage only runs again when the camera, the mesh or the set of visible meshlets changed
+		bool m_IsFrameDirty = true;
+		bool m_AreVerticesDirty = true;
+		bool m_IsIdle = false;
+		//reorder the triangle list for the post-transform cache and the vertices for fetch order right after loading
+		bool m_OptimizeMeshOnLoad = true;
+
+		//Parses the OBJ into mesh and runs the load time optimizations, or reads the result of all that from the mesh cache next to it
+		//a missing or stale cache is rebuilt from the OBJ and written back, then the vertex streams are built in the layout quantizeVertices asks for
+		//runs on a loader thread, so it is static and gets the settings it needs as parameters, and pThreadPool can't be m_pThreadPool
+		static void LoadMesh(const std::string& filename, Mesh& mesh, bool optimizeMesh, bool quantizeVertices, ThreadPool* pThreadPool);
+
+		//Screen is split in TILE_SIZE x TILE_SIZE tiles, each rasterized by one worker at a time
+		static constexpr int TILE_SIZE{ 64 };
+
+		//Cross(b - a, p - a) rewritten as a plane, evaluated at a restart column and stepped by stepX per pixel from there, see CalculateRowEdgeValues
+		struct EdgeFunction
+		{
+			EdgeFunction() = default;
+			EdgeFunction(const Vector2& a, const Vector2& b) :
+				stepX{ a.y - b.y },
+				stepY{ b.x - a.x },
+				origin{ a }
+			{
+			}
+
+			float Evaluate(float x, float y) const
+			{
+				return (stepX * (x - origin.x)) + (stepY * (y - origin.y));
+			}
+
+			float stepX{};
+			float stepY{};
+			Vector2 origin{};
+		};
+
+		//Fixed point rasterization snaps screen positions to 1 / SUBPIXEL_SCALE of a pixel
+		//coverage is then decided with exact integer edge functions and a top-left fill rule,
+		//so a pixel center on an edge shared by two triangles is only drawn by one of them
+		static constexpr int SUBPIXEL_BITS{ 8 };
+		static constexpr int SUBPIXEL_SCALE{ 1 << SUBPIXEL_BITS };
+
+		//Same edge function in sub-pixel units, the products need 64 bits across the whole guard band
+		struct FixedEdgeFunction
+		{
+			FixedEdgeFunction() = default;
+			FixedEdgeFunction(int64_t ax, int64_t ay, int64_t bx, int64_t by) :
+				stepX{ ay - by },
+				stepY{ bx - ax },
+				originX{ ax },
+				originY{ ay }
+			{
+				//inside is the positive side, left edges grow towards +x, top edges are horizontal and grow towards +y (down)
+				//pixel centers exactly on any other edge are pushed out by one
+				const bool isTopLeft{ stepX > 0 or (stepX == 0 and stepY > 0) };
+				bias = isTopLeft ? 0 : -1;
+			}
+
+			//px/py are pixels, evaluated at the pixel center
+			int64_t Evaluate(int px, int py) const
+			{
+				const int64_t x{ (int64_t(px) << SUBPIXEL_BITS) + (SUBPIXEL_SCALE / 2) };
+				const int64_t y{ (int64_t(py) << SUBPIXEL_BITS) + (SUBPIXEL_SCALE / 2) };
+				return (stepX * (x - originX)) + (stepY * (y - originY)) + bias;
+			}
+
+			int64_t stepX{};
+			int64_t stepY{};
+			int64_t originX{};
+			int64_t originY{};
+			int64_t bias{};
+		};
+
+		//value + stepX * dx + stepY * dy, with dx/dy measured from the triangle's planeOrigin
+		struct AttributePlane
+		{
+			float Evaluate(float dx, float dy) const
+			{
+				return value + (stepX * dx) + (stepY * dy);
+			}
+
+			float value{};
+			float stepX{};
+			float stepY{};
+		};
+
+		//Everything the pixel loop needs from a triangle, so it never has to go back to the three Vertex_Out records
+		struct ScreenTriangle
+		{
+			//fetched through the index buffer, so shared vertices are transformed and converted once
+			uint32_t vertexIndices[3]{};
+			//position in m_ScreenTriangles, this is what ends up in the visibility buffer
+			uint32_t id{};
+			int minX{};
+			int maxX{};
+			int minY{};
+			int maxY{};
+
+			//edges[n] runs from vertex n to vertex n + 1, so the weight of a vertex comes from the edge after it
+			EdgeFunction edges[3]{};
+			//only set up when m_UseFixedPointRaster is on
+			FixedEdgeFunction fixedEdges[3]{};
+			float invDoubleArea{};
+
+			//closest vertex depth, used to reject against the hi-z buffer
+			float minZ{};
+
+			//bit (px - minX) + (py - minY) * SMALL_TRIANGLE_SIZE for every covered pixel center,
+			//only used when the bounding box fits in SMALL_TRIANGLE_SIZE x SMALL_TRIANGLE_SIZE, 0 otherwise
+			uint64_t smallCoverageMask{};
+
+			Vector2 planeOrigin{};
+			AttributePlane depthPlane{};
+			AttributePlane invWPlane{};
+
+			//all divided by w
+			AttributePlane uvPlanes[2]{};
+			AttributePlane normalPlanes[3]{};
+			AttributePlane tangentPlanes[3]{};
+			AttributePlane viewDirectionPlanes[3]{};
+		};
+
+		//Pixels are rasterized in horizontal blocks of RASTER_BLOCK_WIDTH, matching one AVX2 register or two SSE registers
+		static constexpr int RASTER_BLOCK_WIDTH{ 8 };
+
+		//All kernels produce bit-identical results, the simd ones just handle a whole block per step
+		enum class RasterKernel
+		{
+			Scalar,
+			SSE,
+			AVX2
+		};
+		RasterKernel m_RasterKernel{ RasterKernel::Scalar };
+
+		//The AVX2 code lives in RendererAVX2.cpp, the only file built with /arch:AVX2, and is only called when the cpu reports AVX2
+		static bool IsAVX2Supported();
+		bool m_IsAVX2Supported{ false };
+
+		//Triangles whose bounding box fits in one SMALL_TRIANGLE_SIZE square have their coverage resolved once during setup
+		static constexpr int SMALL_TRIANGLE_SIZE{ 8 };
+		static_assert(SMALL_TRIANGLE_SIZE * SMALL_TRIANGLE_SIZE <= 64, "small triangle coverage has to fit in a 64 bit mask");
+		//off sends every triangle through RenderStrip, Unit_Tests uses that to check both paths cover the same pixels
+		bool m_UseSmallTrianglePath = true;
+
+		bool SetupTriangle(ScreenTriangle& triangle) const;
+		//The float edge values of a row are evaluated once at a restart column and stepped by stepX per pixel up to the next one
+		//restart columns only depend on the triangle's minX, so a pixel gets the same value whichever tile, strip or path asks for it,
+		//and restarting every EDGE_RESTART_WIDTH pixels keeps a strip far from minX from stepping across the whole screen first
+		static constexpr int EDGE_RESTART_WIDTH{ TILE_SIZE };
+		static_assert(SMALL_TRIANGLE_SIZE <= EDGE_RESTART_WIDTH, "small triangles have to be stepped from minX only");
+		//fills the values of pixels firstX up to lastX of row py, at most TILE_SIZE of them
+		static void CalculateRowEdgeValues(const ScreenTriangle& triangle, int py, int firstX, int lastX, float rowEdgeValues[3][TILE_SIZE]);
+
+		uint64_t CalculateSmallCoverageMask(const ScreenTriangle& triangle) const;
+		uint64_t RenderSmallTriangle(const ScreenTriangle& triangle, int minX, int maxX, int minY, int maxY);
+		uint64_t RenderStrip(const ScreenTriangle& triangle, int minX, int maxX, int minY, int maxY);
+		//blockEdgeValues point at the edge values of pixel blockX in the row, see CalculateRowEdgeValues
+		bool RasterizeBlock(const ScreenTriangle& triangle, int blockX, int py, int nrPixels, const float* const blockEdgeValues[3]);
+		bool RasterizeBlockSSE(const ScreenTriangle& triangle, int blockX, int py, const float* const blockEdgeValues[3]);
+		bool RasterizeBlockFixedPoint(const ScreenTriangle& triangle, int blockX, int py, int nrPixels, const int64_t blockEdgeValues[3]);
+		bool RasterizeBlockAVX2(const ScreenTriangle& triangle, int blockX, int py, const float* const blockEdgeValues[3]);
+		void ShadePixel(const ScreenTriangle& triangle, int px, int py, float interpolatedZ, float interpolatedW);
+		void ShadeVisibilityBuffer(int minX, int maxX, int minY, int maxY);
+
+		//Outcodes of a clip space position, the guard band bit is set when x or y is beyond GUARD_BAND * w
+		enum ClipFlags : uint8_t
+		{
+			ClipLeft		= 1 << 0,
+			ClipRight		= 1 << 1,
+			ClipBottom		= 1 << 2,
+			ClipTop			= 1 << 3,
+			ClipNear		= 1 << 4,
+			ClipFar			= 1 << 5,
+			ClipGuardBand	= 1 << 6
+		};
+
+		//Triangles reaching up to GUARD_BAND times the screen size are rasterized without x/y clipping
+		static constexpr float GUARD_BAND{ 4.0f };
+		//near, far and the four guard band planes
+		static constexpr int NR_CLIP_PLANES{ 6 };
+		static constexpr int MAX_CLIPPED_VERTICES{ 3 + NR_CLIP_PLANES };
+
+		uint8_t GetClipFlags(const Vector4& position) const;
+		float GetClipDistance(const Vector4& position, int clipPlane) const;
+
+		//Which side of the triangles is thrown away before clipping, a triangle is front facing when its vertices go clockwise on screen
+		enum class CullMode
+		{
+			None,
+			Back,
+			Front
+		};
+		CullMode m_CullMode{ CullMode::Back };
+
+		//Determinant of the clip space x, y and w of the three vertices, negative for front facing triangles
+		//unlike the area on screen it keeps the right sign for triangles that still have to be clipped against the near plane
+		float GetClipSpaceDeterminant(const uint32_t vertexIndices[3]) const;
+
+		ThreadPool* m_pThreadPool{ nullptr };
+		int m_NrTilesX{};
+		int m_NrTilesY{};
+		std::vector<ScreenTriangle> m_ScreenTriangles{};
+		std::vector<std::vector<uint32_t>> m_TileBins{};
+
+		//Order in which the triangles get binned, front to back when m_SortFrontToBack is on
+		std::vector<uint32_t> m_TriangleOrder{};
+		std::vector<uint32_t> m_SortScratch{};
+		std::vector<uint16_t> m_SortKeys{};
+		void SortTrianglesFrontToBack();
+
+		//Shaded and covered pixel counts cost a counter per shaded pixel and a scan of the depth buffer per tile, so they are only kept while this is on
+		bool m_CollectPixelStats = false;
+
+		//Every tile counts its own pixels, padded so workers don't fight over the same cache line
+		struct alignas(64) TileStats
+		{
+			uint32_t nrShadedPixels{};
+			uint32_t nrCoveredPixels{};
+		};
+		std::vector<TileStats> m_TileStats{};
+
+		uint64_t m_NrShadedPixels{};
+		uint64_t m_NrCoveredPixels{};
+		uint32_t m_NrStatsFrames{};
+		//last measured without sorting, to compare against
+		float m_UnsortedShadedPixelsPerFrame{};
+
+		//Hierarchical depth: the furthest depth stored in every HIZ_BLOCK_SIZE x HIZ_BLOCK_SIZE block and in every tile
+		//updated right after a triangle writes depth, so later triangles that are fully behind can skip a whole block or tile
+		static constexpr int HIZ_BLOCK_SIZE{ 8 };
+		static constexpr int HIZ_BLOCKS_PER_TILE{ TILE_SIZE / HIZ_BLOCK_SIZE };
+		static_assert(HIZ_BLOCKS_PER_TILE * HIZ_BLOCKS_PER_TILE <= 64, "hi-z blocks of a tile have to fit in a 64 bit mask");
+
+		int m_NrHiZBlocksX{};
+		int m_NrHiZBlocksY{};
+		std::vector<float> m_HiZMaxDepth{};
+		std::vector<float> m_TileMaxDepth{};
+
+		float GetHiZMaxDepth(int minX, int maxX, int minY, int maxY) const;
+		void UpdateHiZ(uint32_t tileIndex, uint64_t writtenHiZBlocks);
 
 		enum class ShadingMode
 		{
@@ -0,0 +1,189 @@
+//This file is built with /arch:AVX2 and only runs after Renderer::IsAVX2Supported said yes
+//it must not call any inline function of the shared headers, the linker could keep the AVX2 copy of it for the whole program
+//that rules out std::vector::operator[], std::min/max and every Vector, Matrix and AttributePlane member,
+//so data comes in through raw pointers and plain struct fields, and the math is written out in intrinsics
+
+//Project includes
+#include "Renderer.h"
+#include "DataTypes.h"
+#include <immintrin.h>
+
+using namespace dae;
+
+bool Renderer::RasterizeBlockAVX2(const ScreenTriangle& triangle, int blockX, int py, const float* const blockEdgeValues[3])
+{
+	//same as RasterizeBlockSSE, but the whole block fits in one register
+	//the triangle is only read field by field, see the top of this file
+	const float planeOriginX{ triangle.planeOrigin.x };
+	const float planeOriginY{ triangle.planeOrigin.y };
+	const float depthPlane[3]{ triangle.depthPlane.value, triangle.depthPlane.stepX, triangle.depthPlane.stepY };
+	const float invWPlane[3]{ triangle.invWPlane.value, triangle.invWPlane.stepX, triangle.invWPlane.stepY };
+
+	const __m256 zero{ _mm256_setzero_ps() };
+
+	const __m256 laneIndices{ _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f) };
+	const __m256 pixelX{ _mm256_add_ps(_mm256_set1_ps(static_cast<float>(blockX)), laneIndices) };
+	const __m256 pixelCenterX{ _mm256_add_ps(pixelX, _mm256_set1_ps(0.5f)) };
+
+	__m256 mask{ _mm256_castsi256_ps(_mm256_set1_epi32(-1)) };
+	for (int edgeIndex{}; edgeIndex < 3; ++edgeIndex)
+	{
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_loadu_ps(blockEdgeValues[edgeIndex]), zero, _CMP_NLT_UQ));
+	}
+
+	if (_mm256_movemask_ps(mask) == 0)
+	{
+		return false;
+	}
+
+	const __m256 dx{ _mm256_sub_ps(pixelCenterX, _mm256_set1_ps(planeOriginX)) };
+	const __m256 dy{ _mm256_set1_ps((static_cast<float>(py) + 0.5f) - planeOriginY) };
+
+	const __m256 interpolatedZ{ _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(depthPlane[0]),
+		_mm256_mul_ps(_mm256_set1_ps(depthPlane[1]), dx)),
+		_mm256_mul_ps(_mm256_set1_ps(depthPlane[2]), dy)) };
+
+	const int pixelIndex{ blockX + (py * m_Width) };
+	const __m256 depth{ _mm256_loadu_ps(m_pDepthBufferPixels + pixelIndex) };
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(depth, interpolatedZ, _CMP_NLT_UQ));
+
+	const int laneMask{ _mm256_movemask_ps(mask) };
+	if (laneMask == 0)
+	{
+		return false;
+	}
+
+	_mm256_storeu_ps(m_pDepthBufferPixels + pixelIndex, _mm256_blendv_ps(depth, interpolatedZ, mask));
+
+	if (m_UseVisibilityBuffer)
+	{
+		for (int lane{}; lane < RASTER_BLOCK_WIDTH; ++lane)
+		{
+			if (laneMask & (1 << lane))
+			{
+				m_pVisibilityBufferPixels[pixelIndex + lane] = triangle.id;
+			}
+		}
+		return true;
+	}
+
+	//same operations as AttributePlane::Evaluate, which can't be called from here
+	const __m256 invW{ _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(invWPlane[0]),
+		_mm256_mul_ps(_mm256_set1_ps(invWPlane[1]), dx)),
+		_mm256_mul_ps(_mm256_set1_ps(invWPlane[2]), dy)) };
+
+	alignas(32) float laneZ[RASTER_BLOCK_WIDTH]{};
+	alignas(32) float laneW[RASTER_BLOCK_WIDTH]{};
+	_mm256_store_ps(laneZ, interpolatedZ);
+	_mm256_store_ps(laneW, _mm256_div_ps(_mm256_set1_ps(1.0f), invW));
+
+	for (int lane{}; lane < RASTER_BLOCK_WIDTH; ++lane)
+	{
+		if (laneMask & (1 << lane))
+		{
+			ShadePixel(triangle, blockX + lane, py, laneZ[lane], laneW[lane]);
+		}
+	}
+
+	return true;
+}
+
+void Renderer::TransformVertexChunkAVX2(const float finalElements[4][4], const float worldElements[3][3], int firstChunkVertex, int lastChunkVertex, const VertexStreamPointers& streams_in, const VertexStreams& vertices_in, VertexOutStreams& vertices_out)
+{
+	//same as the SSE path of TransformVertexChunk, eight vertices at a time
+
+	//every matrix element splatted over a register, [row][column]
+	__m256 finalSplats[4][4]{};
+	__m256 worldSplats[3][3]{};
+	for (int row{}; row < 4; ++row)
+	{
+		for (int column{}; column < 4; ++column)
+		{
+			finalSplats[row][column] = _mm256_set1_ps(finalElements[row][column]);
+			if (row < 3 and column < 3) worldSplats[row][column] = _mm256_set1_ps(worldElements[row][column]);
+		}
+	}
+
+	//Decoding of the quantized streams, see VertexStreams
+	const __m256 positionScale[3]{ _mm256_set1_ps(streams_in.positionScale[0]), _mm256_set1_ps(streams_in.positionScale[1]), _mm256_set1_ps(streams_in.positionScale[2]) };
+	const __m256 positionOffset[3]{ _mm256_set1_ps(streams_in.positionOffset[0]), _mm256_set1_ps(streams_in.positionOffset[1]), _mm256_set1_ps(streams_in.positionOffset[2]) };
+	const __m256 uvScale[2]{ _mm256_set1_ps(streams_in.uvScale[0]), _mm256_set1_ps(streams_in.uvScale[1]) };
+	const __m256 uvOffset[2]{ _mm256_set1_ps(streams_in.uvOffset[0]), _mm256_set1_ps(streams_in.uvOffset[1]) };
+
+	const auto decodeUnorm16{ [](const uint16_t* pValues, __m256 scale, __m256 offset)
+		{
+			const __m256 values{ _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pValues)))) };
+			return _mm256_add_ps(_mm256_mul_ps(values, scale), offset);
+		} };
+	const auto decodeSnorm16{ [](const int16_t* pValues)
+		{
+			const __m256 values{ _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pValues)))) };
+			return _mm256_max_ps(_mm256_mul_ps(values, _mm256_set1_ps(1.0f / VertexStreams::SNORM16_MAX)), _mm256_set1_ps(-1.0f));
+		} };
+	//z is what's left of the manhattan length, the corners folded over for negative z are unfolded by moving x and y back towards the center
+	const auto decodeOctahedral{ [&](const int16_t* pOctahedralX, const int16_t* pOctahedralY, __m256& x, __m256& y, __m256& z)
+		{
+			const __m256 signMask{ _mm256_set1_ps(-0.0f) };
+			const __m256 octahedralX{ decodeSnorm16(pOctahedralX) };
+			const __m256 octahedralY{ decodeSnorm16(pOctahedralY) };
+
+			z = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_andnot_ps(signMask, octahedralX)), _mm256_andnot_ps(signMask, octahedralY));
+			const __m256 fold{ _mm256_max_ps(_mm256_sub_ps(_mm256_setzero_ps(), z), _mm256_setzero_ps()) };
+			x = _mm256_sub_ps(octahedralX, _mm256_or_ps(fold, _mm256_and_ps(octahedralX, signMask)));
+			y = _mm256_sub_ps(octahedralY, _mm256_or_ps(fold, _mm256_and_ps(octahedralY, signMask)));
+
+			const __m256 inverseLength{ _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)))) };
+			x = _mm256_mul_ps(x, inverseLength);
+			y = _mm256_mul_ps(y, inverseLength);
+			z = _mm256_mul_ps(z, inverseLength);
+		} };
+
+	VertexBatch batch{};
+
+	for (int firstVertex{ firstChunkVertex }; firstVertex < lastChunkVertex; firstVertex += AVX2_VERTEX_BATCH_SIZE)
+	{
+		//same products and sums, in the same order, as Matrix::TransformPoint and Matrix::TransformVector
+		__m256 x{}, y{}, z{}, nx{}, ny{}, nz{}, tx{}, ty{}, tz{};
+		if (streams_in.isQuantized)
+		{
+			x = decodeUnorm16(streams_in.pQuantizedPositions[0] + firstVertex, positionScale[0], positionOffset[0]);
+			y = decodeUnorm16(streams_in.pQuantizedPositions[1] + firstVertex, positionScale[1], positionOffset[1]);
+			z = decodeUnorm16(streams_in.pQuantizedPositions[2] + firstVertex, positionScale[2], positionOffset[2]);
+			decodeOctahedral(streams_in.pOctahedralNormals[0] + firstVertex, streams_in.pOctahedralNormals[1] + firstVertex, nx, ny, nz);
+			decodeOctahedral(streams_in.pOctahedralTangents[0] + firstVertex, streams_in.pOctahedralTangents[1] + firstVertex, tx, ty, tz);
+			_mm256_store_ps(batch.uvs[0], decodeUnorm16(streams_in.pQuantizedUVs[0] + firstVertex, uvScale[0], uvOffset[0]));
+			_mm256_store_ps(batch.uvs[1], decodeUnorm16(streams_in.pQuantizedUVs[1] + firstVertex, uvScale[1], uvOffset[1]));
+		}
+		else
+		{
+			x = _mm256_loadu_ps(streams_in.pPositions[0] + firstVertex);
+			y = _mm256_loadu_ps(streams_in.pPositions[1] + firstVertex);
+			z = _mm256_loadu_ps(streams_in.pPositions[2] + firstVertex);
+			nx = _mm256_loadu_ps(streams_in.pNormals[0] + firstVertex);
+			ny = _mm256_loadu_ps(streams_in.pNormals[1] + firstVertex);
+			nz = _mm256_loadu_ps(streams_in.pNormals[2] + firstVertex);
+			tx = _mm256_loadu_ps(streams_in.pTangents[0] + firstVertex);
+			ty = _mm256_loadu_ps(streams_in.pTangents[1] + firstVertex);
+			tz = _mm256_loadu_ps(streams_in.pTangents[2] + firstVertex);
+		}
+
+		for (int column{}; column < 4; ++column)
+		{
+			const __m256 result{ _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(finalSplats[0][column], x), _mm256_mul_ps(finalSplats[1][column], y)),
+				_mm256_mul_ps(finalSplats[2][column], z)), finalSplats[3][column]) };
+			_mm256_store_ps(batch.positions[column], result);
+		}
+
+		for (int column{}; column < 3; ++column)
+		{
+			_mm256_store_ps(batch.normals[column], _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(worldSplats[0][column], nx), _mm256_mul_ps(worldSplats[1][column], ny)),
+				_mm256_mul_ps(worldSplats[2][column], nz)));
+			_mm256_store_ps(batch.tangents[column], _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(worldSplats[0][column], tx), _mm256_mul_ps(worldSplats[1][column], ty)),
+				_mm256_mul_ps(worldSplats[2][column], tz)));
+		}
+
+		//no std::min here, an AVX2 instantiation of it could end up being the one the whole program uses
+		const int nrLanes{ lastChunkVertex - firstVertex < AVX2_VERTEX_BATCH_SIZE ? lastChunkVertex - firstVertex : AVX2_VERTEX_BATCH_SIZE };
+		StoreVertexBatch(batch, firstVertex, nrLanes, vertices_in, vertices_out);
+	}
+}
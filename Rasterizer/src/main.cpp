@@ -60,6 +60,12 @@ int main(int argc, char* args[])
 	while (isLooping)
 	{
 		//--------- Get input events ---------
+		//nothing changed last frame, so sleep until there is input instead of spinning on the same image
+		if (pRenderer->IsIdle())
+		{
+			SDL_WaitEventTimeout(nullptr, 50);
+		}
+
 		SDL_Event e;
 		while (SDL_PollEvent(&e))
 		{
@@ -81,6 +87,22 @@ int main(int argc, char* args[])
 					pRenderer->ToggleUseNormalMap();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
 					pRenderer->ToggleShadingMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					pRenderer->ToggleRasterKernel();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					pRenderer->ToggleVisibilityBuffer();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+					pRenderer->ToggleFrontToBackSort();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+					pRenderer->ToggleFixedPointRaster();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F2)
+					pRenderer->ToggleMeshletCulling();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F1)
+					pRenderer->ToggleCullMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_Q)
+					pRenderer->ToggleQuantizedVertices();
+				if (e.key.keysym.scancode == SDL_SCANCODE_P)
+					pRenderer->TogglePixelStats();
 				break;
 			}
 		}
@@ -98,6 +120,7 @@ int main(int argc, char* args[])
 		{
 			printTimer = 0.f;
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			pRenderer->PrintShadingStats();
 		}
 
 		//Save screenshot after full render
@@ -0,0 +1,175 @@
+#include "gtest/gtest.h"
+#include "DataTypes.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	static constexpr uint64_t SOURCE_HASH{ 0x1234567890abcdef };
+	static constexpr uint32_t BUILD_FLAGS{ 1 };
+
+	//A grid with meshlets and bounds, every vertex different so a mixed up section shows
+	static Mesh CreateCachedMesh()
+	{
+		static constexpr int NR_COLUMNS{ 30 };
+		static constexpr int NR_ROWS{ 20 };
+
+		Mesh mesh{};
+		mesh.primitiveTopology = PrimitiveTopology::TriangleList;
+		for (int row{}; row <= NR_ROWS; ++row)
+		{
+			for (int column{}; column <= NR_COLUMNS; ++column)
+			{
+				Vertex vertex{};
+				vertex.position = Vector3{ column * 0.5f, row * 0.5f, ((column * row) % 5) * 0.1f };
+				vertex.uv = Vector2{ static_cast<float>(column) / NR_COLUMNS, static_cast<float>(row) / NR_ROWS };
+				vertex.normal = Vector3{ 0.1f * column, 0.1f * row, -1.0f }.Normalized();
+				vertex.tangent = Vector3::UnitX;
+				mesh.vertices.push_back(vertex);
+			}
+		}
+
+		for (int row{}; row < NR_ROWS; ++row)
+		{
+			for (int column{}; column < NR_COLUMNS; ++column)
+			{
+				const uint32_t topLeft{ static_cast<uint32_t>((row * (NR_COLUMNS + 1)) + column) };
+				const uint32_t bottomLeft{ topLeft + NR_COLUMNS + 1 };
+				mesh.indices.insert(mesh.indices.end(), { topLeft, bottomLeft, topLeft + 1, topLeft + 1, bottomLeft, bottomLeft + 1 });
+			}
+		}
+
+		MeshOptimizer::BuildMeshlets(mesh.vertices, mesh.indices, mesh.meshletVertices, mesh.meshlets);
+		mesh.CalculateBounds();
+		return mesh;
+	}
+
+	class MeshCacheTest : public testing::Test
+	{
+	protected:
+		void SetUp() override
+		{
+			m_CacheFilename = (std::filesystem::temp_directory_path() / "Unit_Tests_MeshCache.obj.meshcache").string();
+			std::filesystem::remove(m_CacheFilename);
+		}
+
+		void TearDown() override
+		{
+			std::filesystem::remove(m_CacheFilename);
+			std::filesystem::remove(m_CacheFilename + ".tmp");
+		}
+
+		std::vector<char> ReadCacheFile() const
+		{
+			std::ifstream file{ m_CacheFilename, std::ios::binary };
+			return std::vector<char>(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{});
+		}
+
+		void WriteCacheFile(const std::vector<char>& bytes) const
+		{
+			std::ofstream file{ m_CacheFilename, std::ios::binary | std::ios::trunc };
+			file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+		}
+
+		std::string m_CacheFilename{};
+	};
+
+	TEST_F(MeshCacheTest, RoundTrip)
+	{
+		const Mesh savedMesh{ CreateCachedMesh() };
+		ASSERT_FALSE(savedMesh.meshlets.empty());
+		ASSERT_TRUE(MeshCache::Save(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, savedMesh));
+		EXPECT_FALSE(std::filesystem::exists(m_CacheFilename + ".tmp"));
+
+		Mesh loadedMesh{};
+		ASSERT_TRUE(MeshCache::Load(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, loadedMesh));
+
+		ASSERT_EQ(loadedMesh.vertices.size(), savedMesh.vertices.size());
+		EXPECT_EQ(std::memcmp(loadedMesh.vertices.data(), savedMesh.vertices.data(), savedMesh.vertices.size() * sizeof(Vertex)), 0);
+		EXPECT_EQ(loadedMesh.indices, savedMesh.indices);
+		EXPECT_EQ(loadedMesh.meshletVertices, savedMesh.meshletVertices);
+		ASSERT_EQ(loadedMesh.meshlets.size(), savedMesh.meshlets.size());
+		EXPECT_EQ(std::memcmp(loadedMesh.meshlets.data(), savedMesh.meshlets.data(), savedMesh.meshlets.size() * sizeof(Meshlet)), 0);
+		EXPECT_EQ(loadedMesh.localBoundsMin, savedMesh.localBoundsMin);
+		EXPECT_EQ(loadedMesh.localBoundsMax, savedMesh.localBoundsMax);
+
+		//saving the same mesh again gives the same bytes, padding included
+		const std::vector<char> firstBytes{ ReadCacheFile() };
+		ASSERT_TRUE(MeshCache::Save(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, loadedMesh));
+		EXPECT_EQ(ReadCacheFile(), firstBytes);
+	}
+
+	//A stale cache is never read, and the mesh it would have gone into is left alone
+	TEST_F(MeshCacheTest, RejectsMismatches)
+	{
+		ASSERT_TRUE(MeshCache::Save(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, CreateCachedMesh()));
+
+		Mesh mesh{};
+		mesh.indices = { 7, 8, 9 };
+		EXPECT_FALSE(MeshCache::Load(m_CacheFilename, SOURCE_HASH + 1, BUILD_FLAGS, mesh));
+		EXPECT_FALSE(MeshCache::Load(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS + 1, mesh));
+		EXPECT_FALSE(MeshCache::Load(m_CacheFilename + ".missing", SOURCE_HASH, BUILD_FLAGS, mesh));
+
+		//the version is the second uint32 of the file, right after the magic
+		std::vector<char> bytes{ ReadCacheFile() };
+		const uint32_t otherVersion{ MeshCache::VERSION + 1 };
+		std::memcpy(bytes.data() + sizeof(uint32_t), &otherVersion, sizeof(uint32_t));
+		WriteCacheFile(bytes);
+		EXPECT_FALSE(MeshCache::Load(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, mesh));
+
+		//cut off in the middle of a section
+		bytes = ReadCacheFile();
+		bytes.resize(bytes.size() / 2);
+		WriteCacheFile(bytes);
+		EXPECT_FALSE(MeshCache::Load(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, mesh));
+
+		EXPECT_EQ(mesh.indices, (std::vector<uint32_t>{ 7, 8, 9 }));
+		EXPECT_TRUE(mesh.vertices.empty());
+		EXPECT_TRUE(mesh.meshlets.empty());
+	}
+
+	//Indices and meshlet ranges that point outside their arrays can't come out of Load, whatever the header says
+	TEST_F(MeshCacheTest, RejectsOutOfRangeIndices)
+	{
+		const Mesh validMesh{ CreateCachedMesh() };
+		Mesh mesh{};
+
+		Mesh badIndex{ validMesh };
+		badIndex.indices[10] = static_cast<uint32_t>(badIndex.vertices.size());
+		ASSERT_TRUE(MeshCache::Save(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, badIndex));
+		EXPECT_FALSE(MeshCache::Load(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, mesh));
+
+		Mesh badMeshletVertex{ validMesh };
+		badMeshletVertex.meshletVertices.back() = static_cast<uint32_t>(badMeshletVertex.vertices.size()) + 5;
+		ASSERT_TRUE(MeshCache::Save(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, badMeshletVertex));
+		EXPECT_FALSE(MeshCache::Load(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, mesh));
+
+		Mesh badVertexRange{ validMesh };
+		badVertexRange.meshlets.back().nrVertices += 1;
+		ASSERT_TRUE(MeshCache::Save(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, badVertexRange));
+		EXPECT_FALSE(MeshCache::Load(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, mesh));
+
+		Mesh badTriangleRange{ validMesh };
+		badTriangleRange.meshlets.back().nrTriangles += 1;
+		ASSERT_TRUE(MeshCache::Save(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, badTriangleRange));
+		EXPECT_FALSE(MeshCache::Load(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, mesh));
+
+		//large enough to wrap around in 32 bits
+		Mesh wrappingRange{ validMesh };
+		wrappingRange.meshlets.front().firstIndex = UINT32_MAX - 2;
+		ASSERT_TRUE(MeshCache::Save(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, wrappingRange));
+		EXPECT_FALSE(MeshCache::Load(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, mesh));
+
+		EXPECT_TRUE(mesh.vertices.empty());
+
+		ASSERT_TRUE(MeshCache::Save(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, validMesh));
+		EXPECT_TRUE(MeshCache::Load(m_CacheFilename, SOURCE_HASH, BUILD_FLAGS, mesh));
+	}
+}
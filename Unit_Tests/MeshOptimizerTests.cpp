@@ -0,0 +1,175 @@
+#include "gtest/gtest.h"
+#include "DataTypes.h"
+#include "MeshOptimizer.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <filesystem>
+#include <vector>
+
+namespace dae
+{
+	static constexpr uint32_t MAX_MESHLET_VERTICES{ 64 };
+	static constexpr uint32_t MAX_MESHLET_TRIANGLES{ 124 };
+
+	//A closed sphere of latitude rings, with a few triangles that cover no area at all dropped in between
+	static void CreateSphereWithDegenerates(int nrRings, int nrSegments, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		static constexpr float PI{ 3.14159265f };
+
+		for (int ring{}; ring <= nrRings; ++ring)
+		{
+			for (int segment{}; segment <= nrSegments; ++segment)
+			{
+				const float theta{ PI * ring / nrRings };
+				const float phi{ 2.0f * PI * segment / nrSegments };
+
+				Vertex vertex{};
+				vertex.position = Vector3{ std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) } * 10.0f;
+				vertex.normal = vertex.position.Normalized();
+				vertices.push_back(vertex);
+			}
+		}
+
+		for (int ring{}; ring < nrRings; ++ring)
+		{
+			for (int segment{}; segment < nrSegments; ++segment)
+			{
+				const uint32_t topLeft{ static_cast<uint32_t>((ring * (nrSegments + 1)) + segment) };
+				const uint32_t bottomLeft{ topLeft + static_cast<uint32_t>(nrSegments + 1) };
+				indices.insert(indices.end(), { topLeft, topLeft + 1, bottomLeft });
+				indices.insert(indices.end(), { topLeft + 1, bottomLeft + 1, bottomLeft });
+
+				//one that repeats a corner and one with all three corners on a line
+				if ((ring * nrSegments + segment) % 37 == 0)
+				{
+					indices.insert(indices.end(), { topLeft, topLeft, bottomLeft });
+					const uint32_t middle{ static_cast<uint32_t>(vertices.size()) };
+					Vertex middleVertex{ vertices[topLeft] };
+					middleVertex.position = (vertices[topLeft].position + vertices[bottomLeft].position) * 0.5f;
+					vertices.push_back(middleVertex);
+					indices.insert(indices.end(), { topLeft, middle, bottomLeft });
+				}
+			}
+		}
+	}
+
+	static bool IsDegenerate(const std::vector<Vertex>& vertices, const uint32_t* pTriangleIndices)
+	{
+		const Vector3& v0{ vertices[pTriangleIndices[0]].position };
+		return Vector3::Cross(vertices[pTriangleIndices[1]].position - v0, vertices[pTriangleIndices[2]].position - v0).SqrMagnitude() == 0.0f;
+	}
+
+	//Builds meshlets for the mesh and checks everything BuildMeshlets promises about them, and OptimizeMeshlets when optimize is set
+	static void CheckMeshlets(std::vector<Vertex> vertices, std::vector<uint32_t> indices, bool optimize)
+	{
+		//every vertex gets its own number in u, so triangles can be recognized after the vertices were renumbered
+		for (size_t vertex{}; vertex < vertices.size(); ++vertex)
+		{
+			vertices[vertex].uv = Vector2{ static_cast<float>(vertex), 0.0f };
+		}
+
+		std::vector<std::array<float, 3>> inputTriangles{};
+		for (size_t index{}; index + 2 < indices.size(); index += 3)
+		{
+			inputTriangles.push_back({ vertices[indices[index]].uv.x, vertices[indices[index + 1]].uv.x, vertices[indices[index + 2]].uv.x });
+		}
+
+		const size_t nrInputVertices{ vertices.size() };
+		std::vector<uint32_t> meshletVertices{};
+		std::vector<Meshlet> meshlets{};
+		MeshOptimizer::BuildMeshlets(vertices, indices, meshletVertices, meshlets, MAX_MESHLET_VERTICES, MAX_MESHLET_TRIANGLES);
+		ASSERT_FALSE(meshlets.empty());
+
+		if (optimize)
+		{
+			const uint32_t nrMeshletVertices{ static_cast<uint32_t>(vertices.size()) };
+			const float acmrBefore{ MeshOptimizer::CalculateACMR(indices, nrMeshletVertices) };
+			MeshOptimizer::OptimizeMeshlets(vertices, indices, meshletVertices, meshlets);
+			ASSERT_EQ(vertices.size(), nrMeshletVertices);
+			EXPECT_LE(MeshOptimizer::CalculateACMR(indices, nrMeshletVertices), acmrBefore);
+
+			//the vertex stage reads the vertices front to back
+			uint32_t nextVertex{};
+			for (const uint32_t index : indices)
+			{
+				ASSERT_LE(index, nextVertex);
+				nextVertex += (index == nextVertex) ? 1 : 0;
+			}
+			EXPECT_EQ(nextVertex, vertices.size());
+		}
+
+		//border vertices are shared, never copied
+		EXPECT_LE(vertices.size(), nrInputVertices);
+
+		std::vector<std::array<float, 3>> outputTriangles{};
+		uint32_t nextIndex{};
+		for (size_t meshletIndex{}; meshletIndex < meshlets.size(); ++meshletIndex)
+		{
+			const Meshlet& meshlet{ meshlets[meshletIndex] };
+			ASSERT_GT(meshlet.nrTriangles, 0u) << "meshlet " << meshletIndex;
+			ASSERT_LE(meshlet.nrVertices, MAX_MESHLET_VERTICES) << "meshlet " << meshletIndex;
+			ASSERT_LE(meshlet.nrTriangles, MAX_MESHLET_TRIANGLES) << "meshlet " << meshletIndex;
+			ASSERT_LE(meshlet.firstVertex + meshlet.nrVertices, meshletVertices.size()) << "meshlet " << meshletIndex;
+			ASSERT_EQ(meshlet.firstIndex, nextIndex) << "meshlet " << meshletIndex;
+			ASSERT_LE(meshlet.firstIndex + (meshlet.nrTriangles * 3), indices.size()) << "meshlet " << meshletIndex;
+			nextIndex += meshlet.nrTriangles * 3;
+
+			const auto firstMeshletVertex{ meshletVertices.begin() + meshlet.firstVertex };
+			const auto lastMeshletVertex{ firstMeshletVertex + meshlet.nrVertices };
+			std::vector<uint32_t> sortedMeshletVertices(firstMeshletVertex, lastMeshletVertex);
+			std::sort(sortedMeshletVertices.begin(), sortedMeshletVertices.end());
+			EXPECT_EQ(std::adjacent_find(sortedMeshletVertices.begin(), sortedMeshletVertices.end()), sortedMeshletVertices.end()) << "meshlet " << meshletIndex << " lists a vertex twice";
+
+			bool hasDegenerate{};
+			for (uint32_t index{ meshlet.firstIndex }; index < meshlet.firstIndex + (meshlet.nrTriangles * 3); index += 3)
+			{
+				for (uint32_t corner{}; corner < 3; ++corner)
+				{
+					const uint32_t vertex{ indices[index + corner] };
+					ASSERT_LT(vertex, vertices.size());
+					EXPECT_TRUE(std::binary_search(sortedMeshletVertices.begin(), sortedMeshletVertices.end(), vertex)) << "meshlet " << meshletIndex << " uses a vertex it doesn't list";
+
+					const float distance{ (vertices[vertex].position - meshlet.center).Magnitude() };
+					EXPECT_LE(distance, (meshlet.radius * 1.0001f) + 1e-5f) << "meshlet " << meshletIndex << " doesn't hold its triangles";
+				}
+
+				hasDegenerate = hasDegenerate or IsDegenerate(vertices, &indices[index]);
+				outputTriangles.push_back({ vertices[indices[index]].uv.x, vertices[indices[index + 1]].uv.x, vertices[indices[index + 2]].uv.x });
+			}
+
+			//degenerate triangles fit any meshlet, they shouldn't be left on their own
+			EXPECT_FALSE(hasDegenerate and meshlet.nrTriangles == 1) << "meshlet " << meshletIndex << " only holds a degenerate triangle";
+		}
+		EXPECT_EQ(nextIndex, indices.size());
+
+		//every input triangle comes out exactly once, with its winding
+		std::sort(inputTriangles.begin(), inputTriangles.end());
+		std::sort(outputTriangles.begin(), outputTriangles.end());
+		EXPECT_EQ(outputTriangles, inputTriangles);
+	}
+
+	TEST(MeshOptimizer, MeshletsOfSphereWithDegenerates)
+	{
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		CreateSphereWithDegenerates(40, 60, vertices, indices);
+		CheckMeshlets(vertices, indices, false);
+		CheckMeshlets(vertices, indices, true);
+	}
+
+	//paths are relative to this file, like in the ObjParser tests
+	TEST(MeshOptimizer, MeshletsOfVehicle)
+	{
+		const std::filesystem::path filePath{ std::filesystem::path{ __FILE__ }.parent_path() / ".." / "Rasterizer" / "Resources" / "vehicle.obj" };
+
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		ASSERT_TRUE(Utils::ParseOBJ(filePath.string(), vertices, indices));
+		//the same steps as Renderer::LoadMesh
+		MeshOptimizer::OptimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+		CheckMeshlets(vertices, indices, true);
+	}
+}
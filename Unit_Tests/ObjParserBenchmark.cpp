@@ -0,0 +1,60 @@
+#include "gtest/gtest.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+
+namespace dae
+{
+	//Best run instead of the average, the first one also pays for reading the file from disk
+	static double MeasureBestParseSeconds(const std::string& filePath, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, ThreadPool* pThreadPool)
+	{
+		static constexpr int NR_RUNS{ 20 };
+
+		double bestSeconds{ std::numeric_limits<double>::max() };
+		for (int run = 0; run < NR_RUNS; run++)
+		{
+			const auto start{ std::chrono::steady_clock::now() };
+			if (!Utils::ParseOBJ(filePath, vertices, indices, true, pThreadPool))
+			{
+				return 0.0;
+			}
+			const std::chrono::duration<double> elapsed{ std::chrono::steady_clock::now() - start };
+			bestSeconds = std::min(bestSeconds, elapsed.count());
+		}
+		return bestSeconds;
+	}
+
+	//Prints how fast ParseOBJ gets through the assets the rasterizer loads, serial and split over a thread pool
+	//disabled so the default run stays quick, run it with --gtest_also_run_disabled_tests, ObjParserTests checks the results are the same
+	//paths are relative to this file, the test runner's working directory differs between VS and the command line
+	TEST(ObjParser, DISABLED_Throughput)
+	{
+		const std::filesystem::path resourcesPath{ std::filesystem::path{ __FILE__ }.parent_path() / ".." / "Rasterizer" / "Resources" };
+		ThreadPool threadPool{};
+
+		for (const char* filename : { "vehicle.obj", "tuktuk.obj" })
+		{
+			const std::string filePath{ (resourcesPath / filename).string() };
+			const MappedFile file{ filePath };
+			ASSERT_TRUE(file.IsOpen()) << filePath;
+
+			std::vector<Vertex> vertices{};
+			std::vector<uint32_t> indices{};
+			const double serialSeconds{ MeasureBestParseSeconds(filePath, vertices, indices, nullptr) };
+			const double parallelSeconds{ MeasureBestParseSeconds(filePath, vertices, indices, &threadPool) };
+			ASSERT_GT(serialSeconds, 0.0);
+			ASSERT_GT(parallelSeconds, 0.0);
+
+			const double megaBytes{ file.GetSize() / (1024.0 * 1024.0) };
+			std::cout << filename << " (" << megaBytes << " MB): "
+				<< megaBytes / serialSeconds << " MB/s serial, "
+				<< megaBytes / parallelSeconds << " MB/s on " << threadPool.GetNrThreads() << " threads" << std::endl;
+		}
+	}
+}
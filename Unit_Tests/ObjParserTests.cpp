@@ -0,0 +1,198 @@
+#include "gtest/gtest.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	//ParseOBJ only reads files, so the contents go through a file in the temp directory
+	static bool ParseOBJString(const std::string& contents, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, ThreadPool* pThreadPool = nullptr)
+	{
+		const std::filesystem::path filePath{ std::filesystem::temp_directory_path() / "Unit_Tests_ObjParser.obj" };
+		{
+			std::ofstream file{ filePath, std::ios::binary | std::ios::trunc };
+			file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+		}
+
+		const bool isParsed{ Utils::ParseOBJ(filePath.string(), vertices, indices, true, pThreadPool) };
+		std::filesystem::remove(filePath);
+		return isParsed;
+	}
+
+	static bool ParseOBJString(const std::string& contents)
+	{
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		return ParseOBJString(contents, vertices, indices);
+	}
+
+	static const std::string TRIANGLE_POOLS{ "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvt 1 0\nvt 0 1\nvn 0 0 1\n" };
+
+	TEST(ObjParser, ParsesTriangle)
+	{
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		ASSERT_TRUE(ParseOBJString(TRIANGLE_POOLS + "f 1/1/1 2/2/1 3/3/1\n", vertices, indices));
+
+		ASSERT_EQ(vertices.size(), 3u);
+		//by default the winding and z are flipped, and v always is
+		EXPECT_EQ(indices, (std::vector<uint32_t>{ 0, 2, 1 }));
+		EXPECT_EQ(vertices[1].position, Vector3(1.0f, 0.0f, 0.0f));
+		EXPECT_EQ(vertices[2].uv, Vector2(0.0f, 0.0f));
+		EXPECT_EQ(vertices[0].normal, Vector3(0.0f, 0.0f, -1.0f));
+	}
+
+	//The last line ends at the end of the file instead of on a newline, whatever it holds
+	TEST(ObjParser, AcceptsMissingTrailingNewline)
+	{
+		std::vector<Vertex> withNewline{}, withoutNewline{};
+		std::vector<uint32_t> withNewlineIndices{}, withoutNewlineIndices{};
+		ASSERT_TRUE(ParseOBJString(TRIANGLE_POOLS + "f 1/1/1 2/2/1 3/3/1\n", withNewline, withNewlineIndices));
+		ASSERT_TRUE(ParseOBJString(TRIANGLE_POOLS + "f 1/1/1 2/2/1 3/3/1", withoutNewline, withoutNewlineIndices));
+		EXPECT_EQ(withoutNewlineIndices, withNewlineIndices);
+		ASSERT_EQ(withoutNewline.size(), withNewline.size());
+		EXPECT_EQ(withoutNewline[2].position, withNewline[2].position);
+
+		EXPECT_TRUE(ParseOBJString("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\nv 0 0 1"));
+		EXPECT_TRUE(ParseOBJString("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n# no newline after this comment"));
+		EXPECT_TRUE(ParseOBJString("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\r\n"));
+		EXPECT_TRUE(ParseOBJString(""));
+	}
+
+	TEST(ObjParser, RejectsMalformedNumbers)
+	{
+		EXPECT_FALSE(ParseOBJString("v 0 abc 0\n"));
+		EXPECT_FALSE(ParseOBJString("v 0 0\n"));
+		EXPECT_FALSE(ParseOBJString("v 0 0"));
+		EXPECT_FALSE(ParseOBJString("v 1e 0 0\n"));
+		EXPECT_FALSE(ParseOBJString("vt 0.5\n"));
+		EXPECT_FALSE(ParseOBJString("vn 0 - 1\n"));
+		EXPECT_FALSE(ParseOBJString(TRIANGLE_POOLS + "f 1 x 3\n"));
+		EXPECT_FALSE(ParseOBJString(TRIANGLE_POOLS + "f 1 2\n"));
+		EXPECT_FALSE(ParseOBJString(TRIANGLE_POOLS + "f 1/a 2/2 3/3\n"));
+		//relative indices aren't supported
+		EXPECT_FALSE(ParseOBJString(TRIANGLE_POOLS + "f -3 -2 -1\n"));
+
+		//a leading '+' and exponents are fine
+		EXPECT_TRUE(ParseOBJString("v +1 -2.5e1 3E-2\nv 1 0 0\nv 0 1 0\nf 1 2 3\n"));
+	}
+
+	//OBJ indices start at 1, 0 can't point at anything
+	TEST(ObjParser, RejectsIndexZero)
+	{
+		EXPECT_FALSE(ParseOBJString(TRIANGLE_POOLS + "f 0 1 2\n"));
+		EXPECT_FALSE(ParseOBJString(TRIANGLE_POOLS + "f 1/0 2/2 3/3\n"));
+		EXPECT_FALSE(ParseOBJString(TRIANGLE_POOLS + "f 1//0 2//1 3//1\n"));
+	}
+
+	TEST(ObjParser, RejectsOutOfRangeIndices)
+	{
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		EXPECT_FALSE(ParseOBJString(TRIANGLE_POOLS + "f 1 2 4\n", vertices, indices));
+		//nothing of a rejected file is kept
+		EXPECT_TRUE(vertices.empty());
+		EXPECT_TRUE(indices.empty());
+
+		EXPECT_FALSE(ParseOBJString(TRIANGLE_POOLS + "f 1/4 2/2 3/3\n"));
+		EXPECT_FALSE(ParseOBJString(TRIANGLE_POOLS + "f 1//1 2//2 3//1\n"));
+		EXPECT_FALSE(ParseOBJString("f 1 2 3\n"));
+		//a face can use positions that are only defined further down the file
+		EXPECT_TRUE(ParseOBJString("f 1 2 3\nv 0 0 0\nv 1 0 0\nv 0 1 0\n"));
+	}
+
+	//A grid written row by row, every row's faces use the row before it, so faces near a chunk split point at corners of the chunk before
+	//comments, groups, blank lines and crlf endings are mixed in, and a comment pads the file to exactly size bytes
+	static std::string CreateGridOBJ(size_t size)
+	{
+		static constexpr int NR_COLUMNS{ 40 };
+
+		std::string contents{};
+		for (int row{}; contents.size() + 8192 < size; ++row)
+		{
+			contents += (row % 5 == 0) ? "# row " + std::to_string(row) + "\r\ng row" + std::to_string(row) + "\r\n\r\n" : "\n";
+			for (int column{}; column < NR_COLUMNS; ++column)
+			{
+				contents += "v " + std::to_string(column * 0.25f) + " " + std::to_string(row * -0.125f) + " " + std::to_string((column * row) % 7 * 0.01f) + "\n";
+				contents += "vt " + std::to_string(column / float(NR_COLUMNS)) + " " + std::to_string((row % 64) / 64.0f) + "\n";
+			}
+			contents += "vn 0 0 1\n";
+
+			if (row == 0)
+			{
+				continue;
+			}
+
+			//1 based, the normal is the row's only one
+			const int top{ ((row - 1) * NR_COLUMNS) + 1 };
+			const int bottom{ (row * NR_COLUMNS) + 1 };
+			for (int column{}; column + 1 < NR_COLUMNS; ++column)
+			{
+				const std::string corners[4]{
+					std::to_string(top + column) + "/" + std::to_string(top + column) + "/" + std::to_string(row),
+					std::to_string(top + column + 1) + "/" + std::to_string(top + column + 1) + "/" + std::to_string(row),
+					std::to_string(bottom + column) + "/" + std::to_string(bottom + column) + "/" + std::to_string(row + 1),
+					std::to_string(bottom + column + 1) + "/" + std::to_string(bottom + column + 1) + "/" + std::to_string(row + 1) };
+				contents += "f " + corners[0] + " " + corners[1] + " " + corners[2] + ((column % 3 == 0) ? "\r\n" : "\n");
+				contents += "f " + corners[1] + " " + corners[3] + " " + corners[2] + "\n";
+			}
+		}
+
+		contents += "#";
+		contents.append(size - contents.size(), '.');
+		contents.back() = '\n';
+		return contents;
+	}
+
+	//Splitting the file over a thread pool can't change the result, not even in the order of the vertices
+	//sizes are around OBJ_MIN_CHUNK_SIZE, below which a file is never split, and around the first sizes that split it in two and more chunks
+	TEST(ObjParser, ParallelMatchesSerial)
+	{
+		//more threads than this machine might have, so the number of chunks only depends on the size
+		ThreadPool threadPool{ 4 };
+
+		for (const size_t size : { Utils::OBJ_MIN_CHUNK_SIZE - 1, Utils::OBJ_MIN_CHUNK_SIZE + 1, (Utils::OBJ_MIN_CHUNK_SIZE * 2) + 1, (Utils::OBJ_MIN_CHUNK_SIZE * 7) + 13 })
+		{
+			const std::string contents{ CreateGridOBJ(size) };
+			ASSERT_EQ(contents.size(), size);
+
+			std::vector<Vertex> serialVertices{}, parallelVertices{};
+			std::vector<uint32_t> serialIndices{}, parallelIndices{};
+			ASSERT_TRUE(ParseOBJString(contents, serialVertices, serialIndices)) << "size " << size;
+			ASSERT_TRUE(ParseOBJString(contents, parallelVertices, parallelIndices, &threadPool)) << "size " << size;
+
+			EXPECT_FALSE(serialVertices.empty());
+			EXPECT_EQ(serialIndices, parallelIndices) << "size " << size;
+			ASSERT_EQ(serialVertices.size(), parallelVertices.size()) << "size " << size;
+			EXPECT_EQ(std::memcmp(serialVertices.data(), parallelVertices.data(), serialVertices.size() * sizeof(Vertex)), 0) << "size " << size;
+		}
+	}
+
+	//The same for the assets the rasterizer loads, paths are relative to this file
+	TEST(ObjParser, ParallelMatchesSerialForResources)
+	{
+		const std::filesystem::path resourcesPath{ std::filesystem::path{ __FILE__ }.parent_path() / ".." / "Rasterizer" / "Resources" };
+		ThreadPool threadPool{ 4 };
+
+		for (const char* filename : { "vehicle.obj", "tuktuk.obj" })
+		{
+			const std::string filePath{ (resourcesPath / filename).string() };
+
+			std::vector<Vertex> serialVertices{}, parallelVertices{};
+			std::vector<uint32_t> serialIndices{}, parallelIndices{};
+			ASSERT_TRUE(Utils::ParseOBJ(filePath, serialVertices, serialIndices)) << filePath;
+			ASSERT_TRUE(Utils::ParseOBJ(filePath, parallelVertices, parallelIndices, true, &threadPool)) << filePath;
+
+			EXPECT_FALSE(serialVertices.empty());
+			EXPECT_EQ(serialIndices.size() % 3, 0u);
+			EXPECT_EQ(serialIndices, parallelIndices) << filename;
+			ASSERT_EQ(serialVertices.size(), parallelVertices.size()) << filename;
+			EXPECT_EQ(std::memcmp(serialVertices.data(), parallelVertices.data(), serialVertices.size() * sizeof(Vertex)), 0) << filename;
+		}
+	}
+}
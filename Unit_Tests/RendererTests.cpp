@@ -0,0 +1,365 @@
+#include "gtest/gtest.h"
+#include "SDL.h"
+#include "DataTypes.h"
+#include "Renderer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace dae
+{
+	//Friend of Renderer, so the tests can hand it their own triangles and pick the kernels without going through the key bindings
+	class RendererInternals
+	{
+	public:
+		using RasterKernel = Renderer::RasterKernel;
+
+		struct Frame
+		{
+			std::vector<float> depth{};
+			std::vector<uint32_t> colors{};
+		};
+
+		static bool IsAVX2Supported()
+		{
+			return Renderer::IsAVX2Supported();
+		}
+
+		//Replaces whatever the renderer is showing with these triangles, drawn from both sides with an identity world matrix
+		static void SetMesh(Renderer& renderer, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+		{
+			Mesh* pMesh{ new Mesh() };
+			pMesh->vertices = vertices;
+			pMesh->indices = indices;
+			pMesh->primitiveTopology = PrimitiveTopology::TriangleList;
+			pMesh->CalculateBounds();
+			pMesh->Update();
+			pMesh->BuildVertexStreams(renderer.m_UseQuantizedVertices);
+
+			delete renderer.m_Mesh;
+			renderer.m_Mesh = pMesh;
+			renderer.m_CullMode = Renderer::CullMode::None;
+			renderer.m_Camera.CalculateViewMatrix();
+			renderer.m_Camera.CalculateProjectionMatrix();
+			renderer.m_AreVerticesDirty = true;
+		}
+
+		static void SetUseSmallTrianglePath(Renderer& renderer, bool useSmallTrianglePath)
+		{
+			renderer.m_UseSmallTrianglePath = useSmallTrianglePath;
+		}
+
+		static void SetUseFixedPointRaster(Renderer& renderer, bool useFixedPointRaster)
+		{
+			renderer.m_UseFixedPointRaster = useFixedPointRaster;
+			renderer.m_AreVerticesDirty = true;
+		}
+
+		struct TransformedVertices
+		{
+			VertexOutStreams vertices_out{};
+			std::vector<uint8_t> clipFlags{};
+		};
+
+		static void SetWorldMatrix(Renderer& renderer, const Matrix& scale, const Matrix& rotation, const Matrix& translation)
+		{
+			renderer.m_Mesh->scaleTransform = scale;
+			renderer.m_Mesh->rotationTransform = rotation;
+			renderer.m_Mesh->translationTransform = translation;
+			renderer.m_Mesh->isTransformDirty = true;
+			renderer.m_Mesh->Update();
+		}
+
+		static Matrix GetWorldMatrix(const Renderer& renderer)
+		{
+			return renderer.m_Mesh->worldMatrix;
+		}
+
+		static Matrix GetFinalMatrix(const Renderer& renderer)
+		{
+			return renderer.m_Mesh->worldMatrix * renderer.m_Camera.viewMatrix * renderer.m_Camera.projectionMatrix;
+		}
+
+		static Vector3 GetCameraOrigin(const Renderer& renderer)
+		{
+			return renderer.m_Camera.origin;
+		}
+
+		static uint8_t GetClipFlags(const Renderer& renderer, const Vector4& position)
+		{
+			return renderer.GetClipFlags(position);
+		}
+
+		//Runs the vertex stage over the vertices given to SetMesh, the mesh doesn't keep them once its streams are built
+		//useAVX2 picks the path as if the cpu did or didn't have it
+		static TransformedVertices TransformVertices(Renderer& renderer, const std::vector<Vertex>& vertices, bool useAVX2, bool quantize)
+		{
+			Mesh& mesh{ *renderer.m_Mesh };
+			mesh.vertexStreams.Build(vertices, quantize);
+			renderer.m_IsAVX2Supported = useAVX2;
+
+			TransformedVertices transformed{};
+			transformed.vertices_out.Resize(vertices.size());
+			renderer.VertexTransformationFunction(mesh.vertexStreams, transformed.vertices_out);
+			transformed.clipFlags = renderer.m_VertexClipFlags;
+			return transformed;
+		}
+
+		//Clears the buffers like Renderer::Update does and renders one frame with the given kernel
+		static Frame RenderFrame(Renderer& renderer, RasterKernel kernel, bool useVisibilityBuffer)
+		{
+			const int nrPixels{ renderer.m_Width * renderer.m_Height };
+			std::fill_n(renderer.m_pDepthBufferPixels, nrPixels, FLT_MAX);
+			std::fill_n(renderer.m_pVisibilityBufferPixels, nrPixels, Renderer::NO_TRIANGLE);
+			std::fill(renderer.m_HiZMaxDepth.begin(), renderer.m_HiZMaxDepth.end(), FLT_MAX);
+			std::fill(renderer.m_TileMaxDepth.begin(), renderer.m_TileMaxDepth.end(), FLT_MAX);
+
+			renderer.m_RasterKernel = kernel;
+			renderer.m_UseVisibilityBuffer = useVisibilityBuffer;
+			renderer.m_IsFrameDirty = true;
+			renderer.Render();
+
+			Frame frame{};
+			frame.depth.assign(renderer.m_pDepthBufferPixels, renderer.m_pDepthBufferPixels + nrPixels);
+			frame.colors.assign(renderer.m_pBackBufferPixels, renderer.m_pBackBufferPixels + nrPixels);
+			return frame;
+		}
+	};
+
+	//Random triangles in front of the camera, from a few pixels to a good part of the screen, overlapping so the depth test has work to do
+	static void CreateTriangleSoup(int nrTriangles, float minSize, float maxSize, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::mt19937 generator{ 1234 };
+		std::uniform_real_distribution<float> centerX{ -30.0f, 30.0f };
+		std::uniform_real_distribution<float> centerY{ -17.0f, 27.0f };
+		std::uniform_real_distribution<float> centerZ{ -20.0f, 20.0f };
+		std::uniform_real_distribution<float> size{ minSize, maxSize };
+		std::uniform_real_distribution<float> unit{ -1.0f, 1.0f };
+
+		for (int triangle{}; triangle < nrTriangles; ++triangle)
+		{
+			const Vector3 center{ centerX(generator), centerY(generator), centerZ(generator) };
+			const float triangleSize{ size(generator) };
+
+			for (int corner{}; corner < 3; ++corner)
+			{
+				Vertex vertex{};
+				vertex.position = center + Vector3{ unit(generator), unit(generator), unit(generator) * 0.5f } * triangleSize;
+				vertex.uv = Vector2{ (unit(generator) + 1.0f) * 0.5f, (unit(generator) + 1.0f) * 0.5f };
+				vertex.normal = Vector3{ unit(generator) * 0.3f, unit(generator) * 0.3f, -1.0f }.Normalized();
+				vertex.tangent = Vector3::UnitX;
+
+				indices.push_back(static_cast<uint32_t>(vertices.size()));
+				vertices.push_back(vertex);
+			}
+		}
+	}
+
+	//A grid of quads a few pixels wide, so almost every triangle shares all of its edges with its neighbours
+	static void CreateTriangleGrid(int nrColumns, int nrRows, float cellSize, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		const Vector3 corner{ -0.5f * nrColumns * cellSize, 5.0f - (0.5f * nrRows * cellSize), 0.0f };
+		const uint32_t firstVertex{ static_cast<uint32_t>(vertices.size()) };
+
+		for (int row{}; row <= nrRows; ++row)
+		{
+			for (int column{}; column <= nrColumns; ++column)
+			{
+				Vertex vertex{};
+				vertex.position = corner + Vector3{ column * cellSize, row * cellSize, 0.01f * ((column * 7 + row * 3) % 5) };
+				vertex.uv = Vector2{ static_cast<float>(column) / nrColumns, static_cast<float>(row) / nrRows };
+				vertex.normal = -Vector3::UnitZ;
+				vertex.tangent = Vector3::UnitX;
+				vertices.push_back(vertex);
+			}
+		}
+
+		for (int row{}; row < nrRows; ++row)
+		{
+			for (int column{}; column < nrColumns; ++column)
+			{
+				const uint32_t topLeft{ firstVertex + static_cast<uint32_t>((row * (nrColumns + 1)) + column) };
+				const uint32_t bottomLeft{ topLeft + static_cast<uint32_t>(nrColumns + 1) };
+				indices.insert(indices.end(), { topLeft, bottomLeft, topLeft + 1 });
+				indices.insert(indices.end(), { topLeft + 1, bottomLeft, bottomLeft + 1 });
+			}
+		}
+	}
+
+	class RendererTest : public testing::Test
+	{
+	protected:
+		void SetUp() override
+		{
+			SDL_Init(SDL_INIT_VIDEO);
+			m_pWindow = SDL_CreateWindow("Unit_Tests", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 640, 480, SDL_WINDOW_HIDDEN);
+			ASSERT_NE(m_pWindow, nullptr);
+			m_pRenderer = new Renderer(m_pWindow);
+		}
+
+		void TearDown() override
+		{
+			delete m_pRenderer;
+			SDL_DestroyWindow(m_pWindow);
+			SDL_Quit();
+		}
+
+		SDL_Window* m_pWindow{ nullptr };
+		Renderer* m_pRenderer{ nullptr };
+	};
+
+	//The simd kernels claim to give bit-identical depth and color to the scalar one, for every pixel of every triangle
+	TEST_F(RendererTest, RasterKernelsAreBitIdentical)
+	{
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		CreateTriangleSoup(400, 0.2f, 12.0f, vertices, indices);
+		RendererInternals::SetMesh(*m_pRenderer, vertices, indices);
+
+		std::vector<RendererInternals::RasterKernel> simdKernels{ RendererInternals::RasterKernel::SSE };
+		if (RendererInternals::IsAVX2Supported())
+		{
+			simdKernels.push_back(RendererInternals::RasterKernel::AVX2);
+		}
+
+		for (const bool useVisibilityBuffer : { false, true })
+		{
+			const RendererInternals::Frame scalarFrame{ RendererInternals::RenderFrame(*m_pRenderer, RendererInternals::RasterKernel::Scalar, useVisibilityBuffer) };
+			ASSERT_TRUE(std::any_of(scalarFrame.depth.begin(), scalarFrame.depth.end(), [](float depth) { return depth != FLT_MAX; })) << "nothing was drawn";
+
+			for (const RendererInternals::RasterKernel kernel : simdKernels)
+			{
+				const RendererInternals::Frame frame{ RendererInternals::RenderFrame(*m_pRenderer, kernel, useVisibilityBuffer) };
+
+				//memcmp instead of == so a different rounding can't hide behind float comparison rules
+				EXPECT_EQ(std::memcmp(frame.depth.data(), scalarFrame.depth.data(), frame.depth.size() * sizeof(float)), 0)
+					<< "depth differs, kernel " << static_cast<int>(kernel) << ", visibility buffer " << useVisibilityBuffer;
+				EXPECT_EQ(frame.colors, scalarFrame.colors)
+					<< "color differs, kernel " << static_cast<int>(kernel) << ", visibility buffer " << useVisibilityBuffer;
+			}
+		}
+	}
+
+	//Triangles that fit in SMALL_TRIANGLE_SIZE get their coverage from a mask built during setup, that has to pick exactly the pixels RenderStrip would
+	TEST_F(RendererTest, SmallTrianglePathMatchesRenderStrip)
+	{
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		CreateTriangleSoup(3000, 0.05f, 0.8f, vertices, indices);
+		CreateTriangleGrid(120, 90, 0.37f, vertices, indices);
+		RendererInternals::SetMesh(*m_pRenderer, vertices, indices);
+
+		for (const bool useFixedPointRaster : { false, true })
+		{
+			RendererInternals::SetUseFixedPointRaster(*m_pRenderer, useFixedPointRaster);
+
+			RendererInternals::SetUseSmallTrianglePath(*m_pRenderer, true);
+			const RendererInternals::Frame smallFrame{ RendererInternals::RenderFrame(*m_pRenderer, RendererInternals::RasterKernel::Scalar, false) };
+			RendererInternals::SetUseSmallTrianglePath(*m_pRenderer, false);
+			const RendererInternals::Frame stripFrame{ RendererInternals::RenderFrame(*m_pRenderer, RendererInternals::RasterKernel::Scalar, false) };
+
+			size_t nrDifferentPixels{};
+			for (size_t pixel{}; pixel < smallFrame.depth.size(); ++pixel)
+			{
+				if (std::memcmp(&smallFrame.depth[pixel], &stripFrame.depth[pixel], sizeof(float)) != 0 or smallFrame.colors[pixel] != stripFrame.colors[pixel])
+				{
+					++nrDifferentPixels;
+				}
+			}
+			EXPECT_EQ(nrDifferentPixels, 0u) << "fixed point raster " << useFixedPointRaster;
+		}
+	}
+
+	//The simd vertex stage has to give what Matrix::TransformPoint and Matrix::TransformVector give for every vertex, quantized streams up to their precision
+	TEST_F(RendererTest, VertexTransformMatchesMatrix)
+	{
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		//not a multiple of any batch size and more than one VERTEX_CHUNK_SIZE
+		CreateTriangleSoup(1001, 0.2f, 12.0f, vertices, indices);
+		//the soup's tangents all point along x, which would leave most of the tangent math untested
+		for (Vertex& vertex : vertices)
+		{
+			vertex.tangent = Vector3{ vertex.normal.z, 0.2f, -vertex.normal.x }.Normalized();
+		}
+		RendererInternals::SetMesh(*m_pRenderer, vertices, indices);
+		RendererInternals::SetWorldMatrix(*m_pRenderer, Matrix::CreateScale(1.5f, 0.8f, 1.2f), Matrix::CreateRotation(0.3f, 0.7f, -0.2f), Matrix::CreateTranslation(2.0f, -1.0f, 4.0f));
+
+		const Matrix finalMatrix{ RendererInternals::GetFinalMatrix(*m_pRenderer) };
+		const Matrix worldMatrix{ RendererInternals::GetWorldMatrix(*m_pRenderer) };
+		const Vector3 cameraOrigin{ RendererInternals::GetCameraOrigin(*m_pRenderer) };
+
+		std::vector<bool> useAVX2Options{ false };
+		if (RendererInternals::IsAVX2Supported())
+		{
+			useAVX2Options.push_back(true);
+		}
+
+		for (const bool quantize : { false, true })
+		{
+			//unorm16 positions are off by up to half a step of the mesh bounds, octahedral normals by about 1e-4
+			const float positionTolerance{ quantize ? 0.02f : 1e-4f };
+			const float directionTolerance{ quantize ? 1e-3f : 1e-5f };
+
+			for (const bool useAVX2 : useAVX2Options)
+			{
+				const RendererInternals::TransformedVertices transformed{ RendererInternals::TransformVertices(*m_pRenderer, vertices, useAVX2, quantize) };
+
+				for (size_t index{}; index < vertices.size(); ++index)
+				{
+					const Vertex& vertex{ vertices[index] };
+					const Vector4 expectedPosition{ finalMatrix.TransformPoint(Vector4{ vertex.position.x, vertex.position.y, vertex.position.z, 1.0f }) };
+					const Vector3 expectedNormal{ worldMatrix.TransformVector(vertex.normal) };
+					const Vector3 expectedTangent{ worldMatrix.TransformVector(vertex.tangent) };
+
+					const Vector4& position{ transformed.vertices_out.positions[index] };
+					const Vector3& normal{ transformed.vertices_out.normals[index] };
+					const Vector3& tangent{ transformed.vertices_out.tangents[index] };
+					const Vector2& uv{ transformed.vertices_out.uvs[index] };
+					const Vector3& viewDirection{ transformed.vertices_out.viewDirections[index] };
+
+					//clip space grows with distance, so the tolerance does too
+					const float scaledPositionTolerance{ positionTolerance * std::max(1.0f, std::abs(expectedPosition.w)) };
+					ASSERT_NEAR(position.x, expectedPosition.x, scaledPositionTolerance) << "vertex " << index << ", avx2 " << useAVX2 << ", quantized " << quantize;
+					ASSERT_NEAR(position.y, expectedPosition.y, scaledPositionTolerance) << "vertex " << index << ", avx2 " << useAVX2 << ", quantized " << quantize;
+					ASSERT_NEAR(position.z, expectedPosition.z, scaledPositionTolerance) << "vertex " << index << ", avx2 " << useAVX2 << ", quantized " << quantize;
+					ASSERT_NEAR(position.w, expectedPosition.w, scaledPositionTolerance) << "vertex " << index << ", avx2 " << useAVX2 << ", quantized " << quantize;
+
+					for (int axis{}; axis < 3; ++axis)
+					{
+						ASSERT_NEAR(normal[axis], expectedNormal[axis], directionTolerance) << "vertex " << index << ", avx2 " << useAVX2 << ", quantized " << quantize;
+						ASSERT_NEAR(tangent[axis], expectedTangent[axis], directionTolerance) << "vertex " << index << ", avx2 " << useAVX2 << ", quantized " << quantize;
+					}
+
+					ASSERT_NEAR(uv.x, vertex.uv.x, directionTolerance) << "vertex " << index << ", avx2 " << useAVX2 << ", quantized " << quantize;
+					ASSERT_NEAR(uv.y, vertex.uv.y, directionTolerance) << "vertex " << index << ", avx2 " << useAVX2 << ", quantized " << quantize;
+
+					//these follow from the position the stage wrote, so they have to match it exactly
+					EXPECT_EQ(viewDirection.x, position.x - cameraOrigin.x);
+					EXPECT_EQ(viewDirection.y, position.y - cameraOrigin.y);
+					EXPECT_EQ(viewDirection.z, position.z - cameraOrigin.z);
+					EXPECT_EQ(transformed.clipFlags[index], RendererInternals::GetClipFlags(*m_pRenderer, position)) << "vertex " << index;
+				}
+			}
+		}
+
+		//both paths do the same operations in the same order, so they have to agree to the bit
+		if (RendererInternals::IsAVX2Supported())
+		{
+			for (const bool quantize : { false, true })
+			{
+				const RendererInternals::TransformedVertices sse{ RendererInternals::TransformVertices(*m_pRenderer, vertices, false, quantize) };
+				const RendererInternals::TransformedVertices avx2{ RendererInternals::TransformVertices(*m_pRenderer, vertices, true, quantize) };
+
+				EXPECT_EQ(std::memcmp(sse.vertices_out.positions.data(), avx2.vertices_out.positions.data(), vertices.size() * sizeof(Vector4)), 0) << "quantized " << quantize;
+				EXPECT_EQ(std::memcmp(sse.vertices_out.normals.data(), avx2.vertices_out.normals.data(), vertices.size() * sizeof(Vector3)), 0) << "quantized " << quantize;
+				EXPECT_EQ(std::memcmp(sse.vertices_out.tangents.data(), avx2.vertices_out.tangents.data(), vertices.size() * sizeof(Vector3)), 0) << "quantized " << quantize;
+				EXPECT_EQ(std::memcmp(sse.vertices_out.uvs.data(), avx2.vertices_out.uvs.data(), vertices.size() * sizeof(Vector2)), 0) << "quantized " << quantize;
+			}
+		}
+	}
+}